@@ -38,6 +38,8 @@
 
 #include "MAX25x05.h"
 
+#include <cmath>
+
 // STATUS
 #define MAX25_INT_STATUS                        (0x00u)
 // CONFIGURATION
@@ -58,15 +60,61 @@
 // LED CONTROL
 #define MAX25_LED_CTRL                          (0xC1u)
 
+// Field limits of MAX25x05_SequenceConfig
+#define MAX25_SDLY_MAX                          (15u)       // SEQ_CONFIG1[7:4]
+#define MAX25_TIM_MAX                           (7u)        // SEQ_CONFIG1[3:1]
+#define MAX25_NRPT_MAX                          (7u)        // SEQ_CONFIG2[7:5]
+#define MAX25_NCDS_MAX                          (7u)        // SEQ_CONFIG2[4:2]
+#define MAX25_LED_DRV_MAX                       (15u)
+#define MAX25_COL_GAIN_MAX                      (15u)
+#define MAX25_COL_GAIN_UNITY                    (8u)        // 0b1000: gain of 1.00
+
+/*
+* Register values written by set_default_register_settings() besides the sequence configuration
+*/
+static const MAX25x05_RegisterSetting default_registers[] = {
+    {MAX25_MAIN_CONFIG1, 0x04},                 // Set EOCINTE to 1: Enables the end-of-conversion interrupt.
+    {MAX25_MAIN_CONFIG2, 0x02},                 // Not sure why this is set to 0x02
+    {MAX25_AFE_CONGIG, 0x08},                   // Coarse Ambient Light Compensation Enabled
+    {MAX25_LED_CTRL, 0x0A}                      // GAINSEL:1 (Internal trim val), DRV_EN:0 (disabled), ELED_EN:1(enabled), ELED_POL:0 (nMOS)
+};
+
 
 /*
 * This is the interrupt handler for sensor1 to handle end-of-conversion interrupts on the INTB1 pin
 */
 void MAX25x05::intb_handler()
 {
+    if (_data_ready_cb) {
+        _data_ready_cb();
+        return;
+    }
+    if (start_read_on_intb && startSensorPixelRead() == 0) return;
     sensorDataReadyFlag = true;
 }
 
+/*
+* Completion handler of an asynchronous pixel read, called from interrupt context
+*/
+void MAX25x05::pixel_read_handler(int result)
+{
+    if (result != 0) {
+        _read_failures++;
+        sensorDataReadyFlag = true;
+    } else {
+        _raw_complete_index = _raw_read_index;
+        _raw_read_index ^= 1;
+        sensorReadCompleteFlag = true;
+    }
+    if (_read_complete_cb) {
+        _read_complete_cb();
+    }
+}
+
+
+MAX25x05::~MAX25x05() {
+    disable_read_sensor_frames();
+}
 
 void MAX25x05::begin(int hz) {
 
@@ -76,40 +124,294 @@ void MAX25x05::begin(int hz) {
 
 void MAX25x05::set_default_register_settings() {
     
-    uint32_t ledDrvLevel = 0x0F;                                    // 0b1111 max duty cycle 16/16 (200mA)
-
-    INTERFACE_FUNC(reg_write)(MAX25_MAIN_CONFIG1, 0x04);            // Set EOCINTE to 1: Enables the end-of-conversion interrupt.
-    INTERFACE_FUNC(reg_write)(MAX25_MAIN_CONFIG2, 0x02);            // Not sure why this is set to 0x02
-#if defined(MAX25405_DEVICE)
-    INTERFACE_FUNC(reg_write)(MAX25_SEQ_CONGIG1, 0x84);             // Changed to 0x84 (was 0x24) SDLY=2 (sample-delay times), TIM=2 (integration time for the ADC conversion)
-    INTERFACE_FUNC(reg_write)(MAX25_SEQ_CONFIG2, 0x8C);             // NRPT=4 (Number of Repeats), NCDS=3 (Number of Coherent Double Samples)
-#elif defined(MAX25205_DEVICE)
-    INTERFACE_FUNC(reg_write)(MAX25_SEQ_CONGIG1, 0x04); // SDLY=0, TIM=2
-    INTERFACE_FUNC(reg_write)(MAX25_SEQ_CONFIG2, 0xAC); // NRPT=5, NCDS=3
-    ledDrvLevel = 0x0A;
-#endif
-
-    INTERFACE_FUNC(reg_write)(MAX25_AFE_CONGIG, 0x08);              // Coarse Ambient Light Compensation Enabled
-
-    INTERFACE_FUNC(reg_write)(MAX25_LED_CONFIG, ledDrvLevel);       // LED power
-
-    // There are ten different 4-bit column gains for the entire 60-channel array. 
-    // Each trim value applies to one of the ten columns in the pixel array.
-    INTERFACE_FUNC(reg_write)(MAX25_COL_GAIN_2, 0x88);              // 0b1000 for CGAIN2 and 0b1000 for CGAIN1 (gain of 1.00)
-    INTERFACE_FUNC(reg_write)(MAX25_COL_GAIN_4, 0x88);              // 0b1000 for CGAIN4 and 0b1000 for CGAIN3 (gain of 1.00)
-    INTERFACE_FUNC(reg_write)(MAX25_COL_GAIN_6, 0x88);              // 0b1000 for CGAIN6 and 0b1000 for CGAIN5 (gain of 1.00)
-    INTERFACE_FUNC(reg_write)(MAX25_COL_GAIN_8, 0x88);              // 0b1000 for CGAIN8 and 0b1000 for CGAIN7 (gain of 1.00)
-    INTERFACE_FUNC(reg_write)(MAX25_COL_GAIN_10, 0x88);             // 0b1000 for CGAIN10 and 0b1000 for CGAIN9 (gain of 1.00)
-
-    INTERFACE_FUNC(reg_write)(MAX25_LED_CTRL, 0x0A);                // GAINSEL:1 (Internal trim val), DRV_EN:0 (disabled), ELED_EN:1(enabled), ELED_POL:0 (nMOS)
+    MAX25x05_RegisterSetting registers[sizeof(default_registers)/sizeof(default_registers[0]) + MAX25X05_SEQUENCE_CONFIG_REGISTERS];
+    size_t count = default_register_settings(_device, registers, sizeof(registers)/sizeof(registers[0]));
+
+    // The shadow may not match the chip yet, so every register is written
+    for (size_t i = 0; i < count; i++) {
+        reg_set(registers[i].reg, registers[i].value);
+        reg_mark_dirty(registers[i].reg);
+    }
+    commit();
     
 }
 
+size_t MAX25x05::register_settings(MAX25x05_RegisterSetting settings[], const size_t max_settings) const {
+    size_t count = 0;
+    for (unsigned int reg = 0; reg < MAX25X05_NUM_REGISTERS && count < max_settings; reg++) {
+        if (!reg_known(reg)) continue;
+        settings[count].reg = (uint8_t)reg;
+        settings[count].value = _shadow[reg];
+        count++;
+    }
+    return count;
+}
+
+size_t MAX25x05::default_register_settings(const MAX25x05_DeviceType device, MAX25x05_RegisterSetting settings[], const size_t max_settings) {
+    MAX25x05_RegisterSetting sequence[MAX25X05_SEQUENCE_CONFIG_REGISTERS];
+    size_t num_sequence = encode_sequence_config(default_sequence_config(device), sequence);
+    size_t count = 0;
+
+    for (size_t i = 0; i < sizeof(default_registers)/sizeof(default_registers[0]) && count < max_settings; i++) {
+        settings[count++] = default_registers[i];
+    }
+    for (size_t i = 0; i < num_sequence && count < max_settings; i++) settings[count++] = sequence[i];
+
+    // In register order, which is also the order commit() writes them in
+    for (size_t i = 1; i < count; i++) {
+        MAX25x05_RegisterSetting setting = settings[i];
+        size_t j = i;
+        for (; j > 0 && settings[j - 1].reg > setting.reg; j--) settings[j] = settings[j - 1];
+        settings[j] = setting;
+    }
+    return count;
+}
+
+int MAX25x05::set_sequence_config(const MAX25x05_SequenceConfig &config) {
+    MAX25x05_RegisterSetting registers[MAX25X05_SEQUENCE_CONFIG_REGISTERS];
+    size_t count = encode_sequence_config(config, registers);
+    if (count == 0) return -1;
+
+    for (size_t i = 0; i < count; i++) reg_set(registers[i].reg, registers[i].value);
+    return commit() < 0 ? -1 : 0;
+}
+
+int MAX25x05::set_sequence_profile(const MAX25x05_SequenceProfile &profile) {
+    reg_set(MAX25_SEQ_CONGIG1, profile.seq_config1);
+    reg_set(MAX25_SEQ_CONFIG2, profile.seq_config2);
+    return commit() < 0 ? -1 : 0;
+}
+
+MAX25x05_SequenceConfig MAX25x05::default_sequence_config(const MAX25x05_DeviceType device) {
+    MAX25x05_SequenceConfig config;
+
+    if (device == MAX25X05_DEVICE_MAX25205) {
+        config.sdly = 0;                        // SEQ_CONFIG1 0x04: SDLY=0, TIM=2
+        config.tim = 2;
+        config.nrpt = 5;                        // SEQ_CONFIG2 0xAC: NRPT=5, NCDS=3
+        config.ncds = 3;
+        config.led_drive = 0x0A;
+    }
+    else {
+        config.sdly = 8;                        // SEQ_CONFIG1 0x84 (was 0x24): SDLY=8, TIM=2
+        config.tim = 2;
+        config.nrpt = 4;                        // SEQ_CONFIG2 0x8C: NRPT=4, NCDS=3
+        config.ncds = 3;
+        config.led_drive = MAX25_LED_DRV_MAX;   // 0b1111 max duty cycle 16/16 (200mA)
+    }
+    for (unsigned int c = 0; c < SENSOR_COLS; c++) config.col_gains[c] = MAX25_COL_GAIN_UNITY;
+    return config;
+}
+
+/*
+* The idle configuration of the adaptive frame rate only sets the longest sample delay, so the lowest
+* frame rate. Integration time, repeats and LED drive stay as in the active configuration, so the pixel
+* values keep their scale: the detection thresholds hold in both profiles and the background filter
+* sees no step when the profile switches.
+*/
+MAX25x05_SequenceConfig MAX25x05::idle_sequence_config(const MAX25x05_DeviceType device) {
+    MAX25x05_SequenceConfig config = default_sequence_config(device);
+    config.sdly = MAX25_SDLY_MAX;
+    return config;
+}
+
+int MAX25x05::check_sequence_config(const MAX25x05_SequenceConfig &config) {
+    if (config.sdly > MAX25_SDLY_MAX || config.tim > MAX25_TIM_MAX || config.nrpt > MAX25_NRPT_MAX ||
+        config.ncds > MAX25_NCDS_MAX || config.led_drive > MAX25_LED_DRV_MAX) {
+        return -1;
+    }
+    for (unsigned int c = 0; c < SENSOR_COLS; c++) {
+        if (config.col_gains[c] > MAX25_COL_GAIN_MAX) return -1;
+    }
+    return 0;
+}
+
+bool MAX25x05::sequence_config(MAX25x05_SequenceConfig &config) const {
+    if (!reg_known(MAX25_SEQ_CONGIG1) || !reg_known(MAX25_SEQ_CONFIG2)) return false;
+
+    config = default_sequence_config(_device);
+    const uint8_t seq_config1 = _shadow[MAX25_SEQ_CONGIG1];
+    const uint8_t seq_config2 = _shadow[MAX25_SEQ_CONFIG2];
+    config.sdly = (uint8_t)(seq_config1 >> 4);
+    config.tim = (uint8_t)((seq_config1 >> 1) & 0x07u);
+    config.nrpt = (uint8_t)(seq_config2 >> 5);
+    config.ncds = (uint8_t)((seq_config2 >> 2) & 0x07u);
+    if (reg_known(MAX25_LED_CONFIG)) config.led_drive = (uint8_t)(_shadow[MAX25_LED_CONFIG] & 0x0Fu);
+    for (unsigned int c = 0; c < SENSOR_COLS; c += 2) {
+        const uint8_t reg = (uint8_t)(MAX25_COL_GAIN_2 + c/2);
+        if (!reg_known(reg)) continue;
+        config.col_gains[c] = (uint8_t)(_shadow[reg] & 0x0Fu);
+        config.col_gains[c + 1] = (uint8_t)(_shadow[reg] >> 4);
+    }
+    return true;
+}
+
+MAX25x05_SequenceProfile MAX25x05::sequence_profile(const MAX25x05_SequenceConfig &config) {
+    MAX25x05_SequenceProfile profile;
+    profile.seq_config1 = (uint8_t)(((config.sdly & 0x0Fu) << 4) | ((config.tim & 0x07u) << 1));
+    profile.seq_config2 = (uint8_t)(((config.nrpt & 0x07u) << 5) | ((config.ncds & 0x07u) << 2));
+    return profile;
+}
+
+size_t MAX25x05::encode_sequence_config(const MAX25x05_SequenceConfig &config, MAX25x05_RegisterSetting settings[MAX25X05_SEQUENCE_CONFIG_REGISTERS]) {
+    if (check_sequence_config(config) != 0) return 0;
+
+    MAX25x05_SequenceProfile profile = sequence_profile(config);
+    size_t count = 0;
+    settings[count].reg = MAX25_SEQ_CONGIG1;
+    settings[count++].value = profile.seq_config1;
+    settings[count].reg = MAX25_SEQ_CONFIG2;
+    settings[count++].value = profile.seq_config2;
+    settings[count].reg = MAX25_LED_CONFIG;
+    settings[count++].value = config.led_drive;
+
+    // There are ten different 4-bit column gains for the entire 60-channel array. Each register holds
+    // two of them: CGAIN2 in the high nibble and CGAIN1 in the low nibble of COL_GAIN_2, and so on.
+    for (unsigned int c = 0; c < SENSOR_COLS; c += 2) {
+        settings[count].reg = (uint8_t)(MAX25_COL_GAIN_2 + c/2);
+        settings[count++].value = (uint8_t)((config.col_gains[c + 1] << 4) | config.col_gains[c]);
+    }
+    return count;
+}
+
+/*
+* Every row of the array is converted in turn by the column ADCs. A pixel averages 2^NRPT repeats of
+* NCDS+1 coherent double samples, each integrating for TIM_BASE * 2^TIM. SDLY adds a delay before the
+* next frame. Reading a frame transfers the 120 ADC bytes plus the register address (SPI: address and
+* command byte, I2C: device address, register address and repeated start address, 9 clocks a byte).
+*/
+MAX25x05_FrameTiming MAX25x05::frame_timing(const MAX25x05_SequenceConfig &config, const MAX25x05_BusType bus_type, const uint32_t bus_hz) {
+    MAX25x05_FrameTiming timing;
+    const unsigned int repeats = 1u << (config.nrpt & 0x07u);
+    const unsigned int cds = (config.ncds & 0x07u) + 1u;
+    const float integration_us = MAX25X05_TIM_BASE_US * (float)(1u << (config.tim & 0x07u));
+
+    float conversion_us = MAX25X05_CONVERSION_PHASES * repeats * cds * (2.0f * integration_us + MAX25X05_CDS_OVERHEAD_US)
+                        + MAX25X05_FRAME_OVERHEAD_US;
+    float delay_us = MAX25X05_SDLY_STEP_US * (config.sdly & 0x0Fu);
+
+    float bus_clocks = bus_type == MAX25X05_BUS_I2C ? (3.0f + NUM_SENSOR_PIXELS*2) * 9.0f : (2.0f + NUM_SENSOR_PIXELS*2) * 8.0f;
+    float readout_us = bus_hz > 0 ? bus_clocks * 1e6f / (float)bus_hz + MAX25X05_READ_OVERHEAD_US : 0.0f;
+
+    timing.conversion_us = (uint32_t)(conversion_us + 0.5f);
+    timing.delay_us = (uint32_t)(delay_us + 0.5f);
+    timing.frame_us = timing.conversion_us + timing.delay_us;
+    timing.readout_us = (uint32_t)(readout_us + 0.5f);
+    timing.min_period_us = timing.frame_us > timing.readout_us ? timing.frame_us : timing.readout_us;
+    timing.max_frame_rate_hz = timing.min_period_us > 0 ? 1e6f / (float)timing.min_period_us : 0.0f;
+    timing.samples_per_pixel = (uint16_t)(repeats * cds);
+    return timing;
+}
+
+float MAX25x05::relative_snr(const MAX25x05_SequenceConfig &config, const MAX25x05_SequenceConfig &reference) {
+    MAX25x05_FrameTiming t = frame_timing(config, MAX25X05_BUS_SPI, 0);
+    MAX25x05_FrameTiming r = frame_timing(reference, MAX25X05_BUS_SPI, 0);
+    float signal = (float)(1u << (config.tim & 0x07u)) * (float)(config.led_drive + 1u);
+    float reference_signal = (float)(1u << (reference.tim & 0x07u)) * (float)(reference.led_drive + 1u);
+    return (signal / reference_signal) * sqrtf((float)t.samples_per_pixel / (float)r.samples_per_pixel);
+}
+
+bool MAX25x05::fastest_sequence_config(const float min_relative_snr, const MAX25x05_SequenceConfig &reference,
+                                       const MAX25x05_BusType bus_type, const uint32_t bus_hz, MAX25x05_SequenceConfig &config) {
+    bool found = false;
+    uint32_t best_period_us = 0;
+    MAX25x05_SequenceConfig candidate = reference;
+    candidate.sdly = 0;
+
+    for (uint8_t tim = 0; tim <= MAX25_TIM_MAX; tim++) {
+        for (uint8_t nrpt = 0; nrpt <= MAX25_NRPT_MAX; nrpt++) {
+            for (uint8_t ncds = 0; ncds <= MAX25_NCDS_MAX; ncds++) {
+                candidate.tim = tim;
+                candidate.nrpt = nrpt;
+                candidate.ncds = ncds;
+                if (relative_snr(candidate, reference) < min_relative_snr) continue;
+
+                uint32_t period_us = frame_timing(candidate, bus_type, bus_hz).min_period_us;
+                if (!found || period_us < best_period_us) {
+                    found = true;
+                    best_period_us = period_us;
+                    config = candidate;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+/*
+* Rewrites the sequencer configuration, which restarts the conversion cycle: the next end-of-conversion
+* follows one frame period after this call. Used by MAX25x05Array to stagger several sensors.
+*/
+void MAX25x05::restart_conversion() {
+    if (!reg_known(MAX25_SEQ_CONGIG1) || !reg_known(MAX25_SEQ_CONFIG2)) {
+        uint8_t seq_config[2];
+        INTERFACE_FUNC(reg_read)(MAX25_SEQ_CONGIG1, 2, seq_config);
+        reg_set(MAX25_SEQ_CONGIG1, seq_config[0]);
+        reg_set(MAX25_SEQ_CONFIG2, seq_config[1]);
+    }
+    reg_mark_dirty(MAX25_SEQ_CONGIG1);
+    reg_mark_dirty(MAX25_SEQ_CONFIG2);
+    commit();
+}
+
+void MAX25x05::reg_set(const uint8_t reg, const uint8_t value) {
+    if (reg_known(reg) && _shadow[reg] == value) return;
+    _shadow[reg] = value;
+    _shadow_valid[reg >> 5] |= 1u << (reg & 31u);
+    reg_mark_dirty(reg);
+}
+
+void MAX25x05::reg_mark_dirty(const uint8_t reg) {
+    _shadow_dirty[reg >> 5] |= 1u << (reg & 31u);
+}
+
+int MAX25x05::commit() {
+    int transactions = 0;
+    int result = 0;
+    unsigned int reg = 0;
+
+    while (reg < MAX25X05_NUM_REGISTERS) {
+        if (!reg_dirty(reg)) {
+            reg++;
+            continue;
+        }
+
+        // Extend the run over dirty registers and over short gaps of known registers followed by another dirty one
+        unsigned int end = reg + 1;
+        while (end < MAX25X05_NUM_REGISTERS && end - reg < MAX25X05_MAX_WRITE_BURST) {
+            if (reg_dirty(end)) {
+                end++;
+                continue;
+            }
+            unsigned int gap = end;
+            while (gap < MAX25X05_NUM_REGISTERS && gap - end < MAX25X05_SHADOW_MAX_GAP && !reg_dirty(gap) && reg_known(gap)) gap++;
+            if (gap < MAX25X05_NUM_REGISTERS && gap - reg < MAX25X05_MAX_WRITE_BURST && reg_dirty(gap)) end = gap;
+            else break;
+        }
+
+        transactions++;
+        if (INTERFACE_FUNC(reg_write_burst)((uint8_t)reg, (uint8_t)(end - reg), &_shadow[reg]) < 0) {
+            result = -1;
+        }
+        else {
+            for (unsigned int r = reg; r < end; r++) _shadow_dirty[r >> 5] &= ~(1u << (r & 31u));
+        }
+        reg = end;
+    }
+    return result < 0 ? -1 : transactions;
+}
+
+void MAX25x05::invalidate_shadow() {
+    memset(_shadow_valid, 0, sizeof(_shadow_valid));
+    memset(_shadow_dirty, 0, sizeof(_shadow_dirty));
+}
+
 /*
 * This function starts the monitoring of the INTB interrupt
 */
-void MAX25x05::enable_read_sensor_frames(void) {
+void MAX25x05::enable_read_sensor_frames(const bool start_read_on_intb) {
 
+    this->start_read_on_intb = start_read_on_intb;
     _intb.fall(callback(this, &MAX25x05::intb_handler)); // Add INTB interrupt handler
 
     // Read status reg to clear interrupt
@@ -130,20 +432,42 @@ void MAX25x05::disable_read_sensor_frames() {
 
 }
 
+void MAX25x05::attach_data_ready(Callback<void()> func) {
+    _data_ready_cb = func;
+}
+
+void MAX25x05::attach_read_complete(Callback<void()> func) {
+    _read_complete_cb = func;
+}
+
 void MAX25x05::getInterruptStatus(uint8_t &IntValue) {
     INTERFACE_FUNC(reg_read)(MAX25_INT_STATUS, 1, &IntValue);
 }
 
-void MAX25x05::getSensorPixelInts(int16_t pixels[], const bool flip_sensor_pixels) {
+int MAX25x05::getSensorPixelInts(int16_t pixels[], const bool flip_sensor_pixels) {
   unsigned char reg_vals[NUM_SENSOR_PIXELS*2];
-  INTERFACE_FUNC(reg_read)(MAX25_ADC_START_H, NUM_SENSOR_PIXELS*2, reg_vals);
+  if (INTERFACE_FUNC(reg_read)(MAX25_ADC_START_H, NUM_SENSOR_PIXELS*2, reg_vals) < 0) return -1;
+
+  convertSensorPixelInts(reg_vals, pixels, flip_sensor_pixels);
+  return 0;
+}
+
+int MAX25x05::startSensorPixelRead() {
+  return INTERFACE_FUNC(reg_read_async)(MAX25_ADC_START_H, NUM_SENSOR_PIXELS*2, _raw_frame[_raw_read_index],
+                                        callback(this, &MAX25x05::pixel_read_handler));
+}
+
+void MAX25x05::getLastSensorPixelInts(int16_t pixels[], const bool flip_sensor_pixels) {
+  convertSensorPixelInts(_raw_frame[_raw_complete_index], pixels, flip_sensor_pixels);
+}
 
-  for (int i = 0; i < NUM_SENSOR_PIXELS; i++) {
+void MAX25x05::convertSensorPixelInts(const uint8_t reg_vals[], int16_t pixels[], const bool flip_sensor_pixels) {
+  for (unsigned int i = 0; i < NUM_SENSOR_PIXELS; i++) {
     pixels[i] = convertTwoUnsignedBytesToInt(reg_vals[2 * i], reg_vals[2 * i + 1]);
   }
 
   if (flip_sensor_pixels) {
-    for (int i = 0; i < NUM_SENSOR_PIXELS/2; i++) {
+    for (unsigned int i = 0; i < NUM_SENSOR_PIXELS/2; i++) {
       int temp = pixels[i];
       pixels[i] = pixels[NUM_SENSOR_PIXELS-1-i];
       pixels[NUM_SENSOR_PIXELS-1-i] = temp;
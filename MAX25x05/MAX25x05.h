@@ -48,6 +48,70 @@
 #define NUM_SENSOR_PIXELS                       (SENSOR_COLS * SENSOR_ROWS)
 
 
+// Sensor type, selects the register defaults (MAX25x05::set_device_type) and is stored with recordings
+typedef enum {
+    MAX25X05_DEVICE_UNKNOWN = 0,
+    MAX25X05_DEVICE_MAX25405 = 1,
+    MAX25X05_DEVICE_MAX25205 = 2
+} MAX25x05_DeviceType;
+
+typedef enum {
+    MAX25X05_BUS_SPI,
+    MAX25X05_BUS_I2C
+} MAX25x05_BusType;
+
+// One register write of a configuration table
+typedef struct {
+    uint8_t reg;
+    uint8_t value;
+} MAX25x05_RegisterSetting;
+
+// Sequencer settings that set the frame rate: SEQ_CONFIG1 (SDLY, TIM) and SEQ_CONFIG2 (NRPT, NCDS)
+typedef struct {
+    uint8_t seq_config1;
+    uint8_t seq_config2;
+} MAX25x05_SequenceProfile;
+
+// Sequencer, LED and column gain settings (register codes, see MAX25x05::check_sequence_config for the ranges)
+typedef struct {
+    uint8_t sdly;                           // Sample delay between frames, 0-15
+    uint8_t tim;                            // ADC integration time, 0-7, each step doubles it
+    uint8_t nrpt;                           // Repeats, 0-7: 2^nrpt conversions averaged per pixel
+    uint8_t ncds;                           // Coherent double samples, 0-7: ncds+1 per repeat
+    uint8_t led_drive;                      // LED_CONFIG drive level, 0-15 (15: 16/16 duty cycle)
+    uint8_t col_gains[SENSOR_COLS];         // Column gain trims, 0-15 (8: gain 1.00)
+} MAX25x05_SequenceConfig;
+
+#define MAX25X05_SEQUENCE_CONFIG_REGISTERS      (3u + SENSOR_COLS/2)
+
+// Predicted timing of a sequencer configuration (MAX25x05::frame_timing)
+typedef struct {
+    uint32_t conversion_us;                 // Conversion of one frame
+    uint32_t delay_us;                      // Sample delay (SDLY) before the next conversion
+    uint32_t frame_us;                      // Conversion + delay: the period of the end-of-conversion interrupt
+    uint32_t readout_us;                    // Reading the pixels of one frame over the bus
+    uint32_t min_period_us;                 // Shortest sustainable frame period, the larger of frame_us and readout_us
+    float max_frame_rate_hz;
+    uint16_t samples_per_pixel;             // Repeats x coherent double samples
+} MAX25x05_FrameTiming;
+
+// Nominal timing of the frame time model. The sequencer timing is not fully specified, so compare a
+// prediction with a measured frame period (e.g. MAX25x05Array::frame_period_us) and adjust these.
+#define MAX25X05_TIM_BASE_US                    (1.5625f)   // Integration time at TIM=0
+#define MAX25X05_CDS_OVERHEAD_US                (2.0f)      // Settling per coherent double sample
+#define MAX25X05_CONVERSION_PHASES              (SENSOR_ROWS)   // The ten column ADCs convert one row at a time
+#define MAX25X05_FRAME_OVERHEAD_US              (100.0f)
+#define MAX25X05_SDLY_STEP_US                   (2500.0f)   // Sample delay per SDLY step
+#define MAX25X05_READ_OVERHEAD_US               (20.0f)     // Interrupt latency and transaction setup of a frame read
+
+
+// Shadowed register address space and the largest run of clean registers commit() rewrites to join
+// two dirty runs into one burst (cheaper than another transaction header)
+#define MAX25X05_NUM_REGISTERS                  (256u)
+#define MAX25X05_SHADOW_MAX_GAP                 (2u)
+#define MAX25X05_MAX_WRITE_BURST                (32u)
+
+
 /*
 * MAX25x05 Classes
 */
@@ -56,6 +120,31 @@
 #define INTERFACE_FUNC(func)   (_BusInterface->func)
 
 
+/*
+* Ownership of a bus for one transfer. try_lock() tests and takes the lock in a critical section, so an
+* end-of-conversion interrupt cannot start a read between a thread's check and its transfer. Bus
+* interfaces on one physical bus share one lock (MAX25x05Array).
+*/
+class MAX25x05_BusLock
+{
+public:
+    bool try_lock(void)
+    {
+        core_util_critical_section_enter();
+        const bool taken = !_locked;
+        _locked = true;
+        core_util_critical_section_exit();
+        return taken;
+    }
+
+    void unlock(void) { _locked = false; }
+    bool locked(void) const { return _locked; }
+
+private:
+    volatile bool _locked = false;
+};
+
+
 class MAX25x05_BusInterface
 {
 public:
@@ -65,6 +154,25 @@ public:
 
     virtual int reg_read(const uint8_t reg_addr, const uint8_t num_bytes, uint8_t reg_vals[]) = 0;
 
+    // Writes num_bytes (up to MAX25X05_MAX_WRITE_BURST) consecutive registers from reg_addr on.
+    // Returns 0, or -1 if a write failed.
+    // Buses that can send them in one transaction override this.
+    virtual int reg_write_burst(const uint8_t reg_addr, const uint8_t num_bytes, const uint8_t reg_vals[])
+    {
+        for (uint8_t i = 0; i < num_bytes; i++) {
+            if (reg_write(reg_addr + i, reg_vals[i]) < 0) return -1;
+        }
+        return 0;
+    }
+
+    // Non-blocking read. done is called (possibly from interrupt context) with 0 once reg_vals is filled,
+    // or with -1 if the transfer failed and reg_vals holds no valid data.
+    // Returns 0 if the read was started, or -1 if the bus has no asynchronous support or is busy.
+    virtual int reg_read_async(const uint8_t reg_addr, const uint8_t num_bytes, uint8_t reg_vals[], const Callback<void(int)> &done)
+    {
+        return -1;
+    }
+
 };
 
 
@@ -72,8 +180,10 @@ class MAX25x05
 {
 
 public:
-    MAX25x05(MAX25x05_BusInterface &interface, PinName intbpin, PinName rLEDpin = LED1, PinName gLEDpin = LED2):
-        _BusInterface(&interface), _intb(intbpin), _rLED(rLEDpin), _gLED(gLEDpin)
+    // device selects the register defaults of set_default_register_settings()
+    MAX25x05(MAX25x05_BusInterface &interface, PinName intbpin, const MAX25x05_DeviceType device,
+             PinName rLEDpin = LED1, PinName gLEDpin = LED2):
+        _BusInterface(&interface), _device(device), _intb(intbpin), _rLED(rLEDpin), _gLED(gLEDpin)
         {
         };
 
@@ -81,32 +191,143 @@ public:
 
     void begin(int hz);
 
+    // Changes the device type given to the constructor; call before set_default_register_settings()
+    void set_device_type(const MAX25x05_DeviceType device) { _device = device; }
+    MAX25x05_DeviceType device_type(void) const { return _device; }
+
+    // Writes the common register defaults and default_sequence_config() of the device type
     void set_default_register_settings(void);
 
-    void enable_read_sensor_frames(void);
+    // The registers the driver has written or read, in address order, e.g. to store with a recording.
+    // Returns the number of entries written to settings[].
+    size_t register_settings(MAX25x05_RegisterSetting settings[], const size_t max_settings) const;
+
+    // The registers set_default_register_settings() writes for a device type, for tools without a sensor
+    static size_t default_register_settings(const MAX25x05_DeviceType device, MAX25x05_RegisterSetting settings[], const size_t max_settings);
+
+    // Writes the sequencer, LED and column gain registers that differ from config. Returns -1 without
+    // writing anything if config is out of range.
+    int set_sequence_config(const MAX25x05_SequenceConfig &config);
+
+    // Writes SEQ_CONFIG1/2 in one burst if they change, which also restarts the conversion cycle. Call
+    // it between frames, right after a frame has been read, so the conversion in progress is not cut short.
+    // Returns -1 if the write failed, e.g. while an asynchronous pixel read holds the bus; the registers
+    // then stay dirty and the next call or commit() writes them.
+    int set_sequence_profile(const MAX25x05_SequenceProfile &profile);
+
+    // The settings of set_default_register_settings(), and the same with the longest sample delay the adaptive
+    // frame rate (MAX25x05AdaptiveRate) runs while nothing is in view
+    static MAX25x05_SequenceConfig default_sequence_config(const MAX25x05_DeviceType device);
+    static MAX25x05_SequenceConfig idle_sequence_config(const MAX25x05_DeviceType device);
+
+    // Returns 0 if every field of config is in range, -1 otherwise
+    static int check_sequence_config(const MAX25x05_SequenceConfig &config);
+
+    // Register values of a config: SEQ_CONFIG1/2 only, or all MAX25X05_SEQUENCE_CONFIG_REGISTERS of them.
+    // encode_sequence_config() returns the number of registers, 0 if config is out of range.
+    static MAX25x05_SequenceProfile sequence_profile(const MAX25x05_SequenceConfig &config);
+    static size_t encode_sequence_config(const MAX25x05_SequenceConfig &config, MAX25x05_RegisterSetting settings[MAX25X05_SEQUENCE_CONFIG_REGISTERS]);
+
+    // Frame time model: conversion time, frame period and the highest frame rate config sustains when
+    // every frame is read over a bus_type bus at bus_hz
+    static MAX25x05_FrameTiming frame_timing(const MAX25x05_SequenceConfig &config, const MAX25x05_BusType bus_type, const uint32_t bus_hz);
+
+    // Signal to noise ratio of config relative to reference, modelled as integration time x LED drive
+    // x sqrt(samples per pixel) (read noise limited)
+    static float relative_snr(const MAX25x05_SequenceConfig &config, const MAX25x05_SequenceConfig &reference);
+
+    // Searches TIM, NRPT and NCDS (SDLY 0, LED drive and gains of reference) for the shortest frame period
+    // with at least min_relative_snr. Returns false if no setting reaches it.
+    static bool fastest_sequence_config(const float min_relative_snr, const MAX25x05_SequenceConfig &reference,
+                                        const MAX25x05_BusType bus_type, const uint32_t bus_hz, MAX25x05_SequenceConfig &config);
+
+    // The sequencer configuration in the shadow copy, fields never written taken from default_sequence_config().
+    // Returns false if SEQ_CONFIG1/2 have not been written or read yet.
+    bool sequence_config(MAX25x05_SequenceConfig &config) const;
+
+    // Restarts the conversion sequence with the current sequencer settings (phase alignment of several sensors)
+    void restart_conversion(void);
+
+    // Shadow copy of the configuration registers. reg_set() only updates the copy and marks the register
+    // dirty if its value changes (or was never written); commit() then writes every dirty register, each
+    // run of consecutive registers as one burst. Returns the number of bus transactions, or -1 if a
+    // write failed (those registers stay dirty).
+    void reg_set(const uint8_t reg, const uint8_t value);
+    uint8_t reg_get(const uint8_t reg) const { return _shadow[reg]; }
+    bool reg_known(const uint8_t reg) const { return shadow_bit(_shadow_valid, reg); }
+    bool reg_dirty(const uint8_t reg) const { return shadow_bit(_shadow_dirty, reg); }
+    int commit(void);
+
+    // Forgets the shadow copy, e.g. after the sensor has been reset or powered down
+    void invalidate_shadow(void);
+
+    // With start_read_on_intb set, each end-of-conversion interrupt starts an asynchronous pixel read
+    // (SPI; I2C cannot start one from an interrupt) and sensorReadCompleteFlag is set once the frame is in the driver.
+    // Otherwise, or if the read cannot be started, sensorDataReadyFlag is set as before.
+    void enable_read_sensor_frames(const bool start_read_on_intb = false);
 
     void disable_read_sensor_frames(void);
 
+    // Called from the end-of-conversion interrupt instead of setting the flags / starting a read,
+    // e.g. to wake the thread that reads the frame. Pass NULL to detach.
+    void attach_data_ready(Callback<void()> func);
+
+    // Called from interrupt context when an asynchronous pixel read has finished, after
+    // sensorReadCompleteFlag (success) or sensorDataReadyFlag (failure) is set. Pass NULL to detach.
+    void attach_read_complete(Callback<void()> func);
+
     void getInterruptStatus(uint8_t &IntValue);
 
-    void getSensorPixelInts(int16_t pixels[], const bool flip_sensor_pixels);
+    // Blocking pixel read. Returns -1 with pixels unchanged if the bus is taken, e.g. by an asynchronous read.
+    int getSensorPixelInts(int16_t pixels[], const bool flip_sensor_pixels);
+
+    // Asynchronous readout: startSensorPixelRead() returns as soon as the read is running so the
+    // previous frame can be processed meanwhile. Once sensorReadCompleteFlag is set,
+    // getLastSensorPixelInts() converts the frame. Returns -1 if the bus cannot read asynchronously.
+    // A read that fails leaves the last frame in place, is counted, and sets sensorDataReadyFlag so the
+    // frame can still be read with getSensorPixelInts() before the next conversion ends.
+    int startSensorPixelRead(void);
+    uint32_t read_failures(void) const { return _read_failures; }
+
+    void getLastSensorPixelInts(int16_t pixels[], const bool flip_sensor_pixels);
 
     // Data ready flags
     volatile bool sensorDataReadyFlag = false; // Data ready flag, set by the end-of-conversion interrupt
+    volatile bool sensorReadCompleteFlag = false; // Set when an asynchronous pixel read has completed
 
 private:
 
     void intb_handler(void);
+    void pixel_read_handler(int result);
+    void convertSensorPixelInts(const uint8_t reg_vals[], int16_t pixels[], const bool flip_sensor_pixels);
     int16_t convertTwoUnsignedBytesToInt(uint8_t hi_byte, uint8_t lo_byte);
+    void reg_mark_dirty(const uint8_t reg);
+
+    static bool shadow_bit(const uint32_t bits[], const uint8_t reg) { return (bits[reg >> 5] >> (reg & 31u)) & 1u; }
 
     MAX25x05_BusInterface *_BusInterface;
+    MAX25x05_DeviceType _device;
+
+    InterruptIn _intb;
 
     DigitalOut _rLED;
     DigitalOut _gLED;
 
-    InterruptIn _intb;
-
     bool read_sensor_frames_enabled = false;
+    bool start_read_on_intb = false;
+    Callback<void()> _data_ready_cb;
+    Callback<void()> _read_complete_cb;
+
+    // Asynchronous reads alternate between two buffers so a completed frame is not overwritten by the next read
+    uint8_t _raw_frame[2][NUM_SENSOR_PIXELS*2];
+    uint8_t _raw_read_index = 0;
+    volatile uint8_t _raw_complete_index = 0;
+    volatile uint32_t _read_failures = 0;
+
+    // Register shadow: values, which are known and which still have to be written
+    uint8_t _shadow[MAX25X05_NUM_REGISTERS] = {};
+    uint32_t _shadow_valid[MAX25X05_NUM_REGISTERS / 32] = {};
+    uint32_t _shadow_dirty[MAX25X05_NUM_REGISTERS / 32] = {};
 
 };
 
@@ -0,0 +1,68 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* MAX25x05AdaptiveRate: detection driven sequencer profile switching
+*/
+
+#include "MAX25x05AdaptiveRate.h"
+
+bool MAX25x05AdaptiveRate::update(const int maxpixel) {
+    if (_mode == RATE_IDLE) {
+        _idle_frames++;
+        if (maxpixel < _start_threshold) return false;
+
+        _mode = RATE_ACTIVE;
+        _quiet_frames = 0;
+        _switches++;
+        return true;
+    }
+
+    _active_frames++;
+    if (maxpixel >= _end_threshold) {
+        _quiet_frames = 0;
+        return false;
+    }
+    if (++_quiet_frames < _hold_frames) return false;
+
+    _mode = RATE_IDLE;
+    _switches++;
+    return true;
+}
+
+void MAX25x05AdaptiveRate::reset() {
+    _mode = RATE_IDLE;
+    _quiet_frames = 0;
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* MAX25x05AdaptiveRate: switches a MAX25x05 between a slow idle and a fast active sequencer profile
+*
+* While nothing is in view the sensor runs the idle profile (MAX25x05::idle_sequence_config: longest
+* sample delay, pixel values on the same scale), so there are fewer frames to read and process. As soon as the
+* maximum pixel of a processed frame reaches the start threshold the controller asks for the active
+* profile, which is kept until the maximum pixel has stayed below the end threshold for hold_frames
+* frames in a row. The gap between the two thresholds and the hold time keep a hand at the edge of
+* the field of view from toggling the rate.
+*
+* Feed update() with the maximum pixel of every processed frame (gesture_lib dynamicResult.maxpixel)
+* and apply profile() whenever it returns true, between frames: gesture_pipeline::set_sequence_profile()
+* or MAX25x05::set_sequence_profile(). The controller does not touch the bus itself.
+*/
+
+#ifndef __MAX25X05_ADAPTIVE_RATE_H__
+#define __MAX25X05_ADAPTIVE_RATE_H__
+
+#include "MAX25x05.h"
+
+// Frames below the end threshold before dropping back to the idle profile
+#define MAX25X05_ADAPTIVE_RATE_HOLD_FRAMES      (20u)
+
+
+class MAX25x05AdaptiveRate
+{
+
+public:
+    typedef enum {
+        RATE_IDLE,
+        RATE_ACTIVE
+    } RateMode;
+
+    // Starts in the idle profile, which the caller applies once (profile()) after the register defaults.
+    // The profiles are the idle and default sequence configurations of the device type, or given ones.
+    MAX25x05AdaptiveRate(const int start_threshold, const int end_threshold, const MAX25x05_DeviceType device,
+                         const uint16_t hold_frames = MAX25X05_ADAPTIVE_RATE_HOLD_FRAMES):
+        _start_threshold(start_threshold), _end_threshold(end_threshold), _hold_frames(hold_frames),
+        _idle(MAX25x05::sequence_profile(MAX25x05::idle_sequence_config(device))),
+        _active(MAX25x05::sequence_profile(MAX25x05::default_sequence_config(device)))
+        {
+        };
+    MAX25x05AdaptiveRate(const int start_threshold, const int end_threshold, const MAX25x05_SequenceProfile &idle,
+                         const MAX25x05_SequenceProfile &active, const uint16_t hold_frames = MAX25X05_ADAPTIVE_RATE_HOLD_FRAMES):
+        _start_threshold(start_threshold), _end_threshold(end_threshold), _hold_frames(hold_frames), _idle(idle), _active(active)
+        {
+        };
+
+    // Feeds the maximum pixel of a processed frame. Returns true if the sensor should switch to profile().
+    bool update(const int maxpixel);
+
+    // Back to the idle profile without a switch request, e.g. after resetGesture()
+    void reset(void);
+
+    RateMode mode(void) const { return _mode; }
+    const MAX25x05_SequenceProfile &profile(void) const { return _mode == RATE_ACTIVE ? _active : _idle; }
+
+    // Counters
+    uint32_t switches(void) const { return _switches; }
+    uint32_t idle_frames(void) const { return _idle_frames; }
+    uint32_t active_frames(void) const { return _active_frames; }
+
+private:
+    const int _start_threshold;
+    const int _end_threshold;
+    const uint16_t _hold_frames;
+    const MAX25x05_SequenceProfile _idle;
+    const MAX25x05_SequenceProfile _active;
+
+    RateMode _mode = RATE_IDLE;
+    uint16_t _quiet_frames = 0;
+
+    uint32_t _switches = 0;
+    uint32_t _idle_frames = 0;
+    uint32_t _active_frames = 0;
+
+};
+
+
+#endif // __MAX25X05_ADAPTIVE_RATE_H__
@@ -0,0 +1,242 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* MAX25x05Array: 2-4 MAX25x05 sensors with staggered conversions
+*/
+
+#include "MAX25x05Array.h"
+
+#include <new>
+
+MAX25x05Array::~MAX25x05Array() {
+    stop();
+    for (uint8_t k = 0; k < _count; k++) {
+        _sensors[k]->~MAX25x05();
+    }
+}
+
+int MAX25x05Array::add_sensor(MAX25x05_BusInterface &interface, PinName intbpin, const MAX25x05_DeviceType device,
+                              PinName rLEDpin, PinName gLEDpin) {
+    if (_count >= MAX25X05_ARRAY_MAX_SENSORS) return -1;
+
+    _sensors[_count] = new (_sensor_storage[_count]) MAX25x05(interface, intbpin, device, rLEDpin, gLEDpin);
+    _intb_slots[_count].array = this;
+    _intb_slots[_count].index = _count;
+    return _count++;
+}
+
+void MAX25x05Array::begin(int hz) {
+    for (uint8_t k = 0; k < _count; k++) {
+        _sensors[k]->begin(hz);
+    }
+}
+
+void MAX25x05Array::set_default_register_settings() {
+    for (uint8_t k = 0; k < _count; k++) {
+        _sensors[k]->set_default_register_settings();
+    }
+}
+
+bool MAX25x05Array::start(const uint32_t frame_period_us) {
+    if (_count == 0) return false;
+
+    _clock.reset();
+    _clock.start();
+    for (uint8_t k = 0; k < _count; k++) {
+        _sensors[k]->attach_data_ready(callback(&_intb_slots[k], &intb_slot::handler));
+        _sensors[k]->enable_read_sensor_frames();
+    }
+
+    _frame_period_us = frame_period_us;
+    if (_frame_period_us == 0) {
+        if (!wait_for_conversions(1u)) {
+            stop();
+            return false;
+        }
+        const uint32_t t0 = _intb_timestamp_us[0];
+        if (!wait_for_conversions(1u)) {
+            stop();
+            return false;
+        }
+        _frame_period_us = _intb_timestamp_us[0] - t0;
+    }
+    _slot_us = _frame_period_us / _count;
+    _frames_read_mask = 0;
+
+    if (!conversions_fit() || !stagger()) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void MAX25x05Array::stop() {
+    for (uint8_t k = 0; k < _count; k++) {
+        _sensors[k]->disable_read_sensor_frames();
+        _sensors[k]->attach_data_ready(Callback<void()>());
+    }
+    core_util_atomic_store_u32(&_ready_mask, 0);
+    _clock.stop();
+}
+
+bool MAX25x05Array::check_schedule() {
+    if (_count < 2 || _frames_read_mask != all_sensors_mask()) return false;
+
+    for (uint8_t k = 1; k < _count; k++) {
+        int32_t error = phase_error(k, _frame_timestamp_us[0], _frame_timestamp_us[k]);
+        if (error > (int32_t)MAX25X05_ARRAY_SYNC_GUARD_US || error < -(int32_t)MAX25X05_ARRAY_SYNC_GUARD_US) {
+            if (!stagger()) _restagger_failures++;
+            _resyncs++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MAX25x05Array::read_frames() {
+    const uint32_t mask = _ready_mask;
+    for (uint8_t k = 0; k < _count; k++) {
+        const uint32_t bit = 1u << k;
+        if ((mask & bit) == 0) continue;
+
+        // Cleared before the read so an end-of-conversion during the read is not lost
+        _frame_timestamp_us[k] = _intb_timestamp_us[k];
+        core_util_atomic_fetch_and_u32(&_ready_mask, ~bit);
+        if (_sensors[k]->getSensorPixelInts(_frames[k], _flip) < 0) {
+            core_util_atomic_fetch_or_u32(&_ready_mask, bit);     // bus taken: read it on the next call
+            continue;
+        }
+        _frames_read_mask |= bit;
+    }
+}
+
+void MAX25x05Array::stitch_frames(int16_t wide[]) const {
+    const uint32_t wide_cols = SENSOR_COLS * _count;
+    for (uint8_t k = 0; k < _count; k++) {
+        for (uint32_t row = 0; row < SENSOR_ROWS; row++) {
+            memcpy(&wide[row * wide_cols + k * SENSOR_COLS], &_frames[k][row * SENSOR_COLS], SENSOR_COLS * sizeof(int16_t));
+        }
+    }
+}
+
+/*
+* End-of-conversion interrupt of sensor index
+*/
+void MAX25x05Array::intb_handler(const uint8_t index) {
+    const uint32_t bit = 1u << index;
+    _intb_timestamp_us[index] = now_us();
+    if (core_util_atomic_fetch_or_u32(&_ready_mask, bit) & bit) _missed_conversions++;
+}
+
+/*
+* Sleeps until shortly before deadline_us and spins for the rest, so a restart is placed to within a few
+* microseconds without busy-waiting for most of a slot
+*/
+void MAX25x05Array::wait_until(const uint32_t deadline_us) const {
+    int32_t remaining_us = (int32_t)(deadline_us - now_us());
+    if (remaining_us > (int32_t)MAX25X05_ARRAY_SPIN_US) {
+        // sleep_for() may overshoot by up to a tick, so stop a millisecond early
+        ThisThread::sleep_for(std::chrono::milliseconds(remaining_us / 1000 - 1));
+        remaining_us = (int32_t)(deadline_us - now_us());
+    }
+    if (remaining_us > 0) wait_us(remaining_us);
+}
+
+/*
+* Discards any pending frames of the sensors in mask and waits for the next end-of-conversion of each
+*/
+bool MAX25x05Array::wait_for_conversions(const uint32_t mask) {
+    core_util_atomic_fetch_and_u32(&_ready_mask, ~mask);
+
+    const uint32_t start_us = now_us();
+    while ((_ready_mask & mask) != mask) {
+        if (now_us() - start_us > MAX25X05_ARRAY_START_TIMEOUT_US) return false;
+        ThisThread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/*
+* How far sensor index converted from its slot, k slots after sensor 0, folded into +-half a frame period
+*/
+int32_t MAX25x05Array::phase_error(const uint8_t index, const uint32_t timestamp0_us, const uint32_t timestamp_us) const {
+    const int32_t period = (int32_t)_frame_period_us;
+    int32_t offset = (int32_t)(timestamp_us - timestamp0_us) % period;
+    if (offset < 0) offset += period;
+
+    int32_t error = offset - (int32_t)(index * _slot_us);
+    if (error > period/2) error -= period;
+    else if (error < -period/2) error += period;
+    return error;
+}
+
+/*
+* Each conversion, LED pulses included, has to end before the next sensor's slot begins
+*/
+bool MAX25x05Array::conversions_fit() const {
+    for (uint8_t k = 0; k < _count; k++) {
+        MAX25x05_SequenceConfig config;
+        if (!_sensors[k]->sequence_config(config)) config = MAX25x05::default_sequence_config(_sensors[k]->device_type());
+        if (MAX25x05::frame_timing(config, MAX25X05_BUS_SPI, 0).conversion_us + MAX25X05_ARRAY_SYNC_GUARD_US > _slot_us) return false;
+    }
+    return true;
+}
+
+/*
+* Restarts sensors 1..N-1 one slot apart, starting one slot after an end-of-conversion of sensor 0.
+* Sensor k then converts k slots after sensor 0 in every frame period. The next conversion of every
+* sensor confirms it: returns false if one is more than MAX25X05_ARRAY_SYNC_GUARD_US out of its slot.
+*/
+bool MAX25x05Array::stagger() {
+    if (!wait_for_conversions(1u)) return false;
+    const uint32_t t0 = _intb_timestamp_us[0];
+
+    for (uint8_t k = 1; k < _count; k++) {
+        wait_until(t0 + k * _slot_us);
+        _sensors[k]->restart_conversion();
+    }
+
+    bool in_slots = wait_for_conversions(all_sensors_mask());
+    for (uint8_t k = 1; k < _count && in_slots; k++) {
+        int32_t error = phase_error(k, _intb_timestamp_us[0], _intb_timestamp_us[k]);
+        in_slots = error <= (int32_t)MAX25X05_ARRAY_SYNC_GUARD_US && error >= -(int32_t)MAX25X05_ARRAY_SYNC_GUARD_US;
+    }
+
+    // Frames converted while restaggering belong to the old schedule
+    core_util_atomic_store_u32(&_ready_mask, 0);
+    _frames_read_mask = 0;
+    return in_slots;
+}
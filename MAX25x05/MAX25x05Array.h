@@ -0,0 +1,203 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* MAX25x05Array: 2-4 MAX25x05 sensors side by side covering a wider field of view
+*
+* All sensors run the same sequencer settings, so they share one frame period. If their conversions
+* overlapped, each sensor would also see the emitter pulses of its neighbours. start() therefore
+* staggers the conversions: sensor k is restarted k/N of a frame period after sensor 0, so the LED
+* pulses of the sensors take turns and every sensor still runs at the full frame rate. That needs the
+* conversion (MAX25x05::frame_timing) to fit into its slot of a frame period, which start() checks.
+* The restart rewrites SEQ_CONFIG1/2 (MAX25x05::restart_conversion); the datasheet does not say that
+* this restarts the cycle, so start() measures the phase each sensor ends up with and reports failure
+* if a sensor is not in its slot. The sensor clocks are independent and drift apart slowly;
+* check_schedule() measures the phase of each sensor from its INTB timestamps and restaggers the array
+* when a sensor drifts out of its slot.
+*
+* Once the last sensor of a cycle has converted, read_frames() reads all sensors back-to-back. The
+* frames can then be copied into one gesture_lib per sensor (copy_frames) or stitched into a single
+* (SENSOR_COLS*N) x SENSOR_ROWS frame for a basic_gesture_lib of that size (copy_stitched_frame).
+* Sensors are added left to right, either on a shared bus (one bus interface per chip select or I2C
+* address) or on separate buses. Sensors on one SPI bus must share its bus_lock(), so an asynchronous
+* read of one sensor keeps the others off the bus.
+*
+* Waits of more than a few milliseconds sleep (ThisThread::sleep_for); only the last stretch before a
+* restart, under two milliseconds, is timed with wait_us().
+*/
+
+#ifndef __MAX25X05_ARRAY_H__
+#define __MAX25X05_ARRAY_H__
+
+#include "mbed.h"
+#include "MAX25x05.h"
+
+#define MAX25X05_ARRAY_MAX_SENSORS              (4u)
+
+// Largest phase error (us) before check_schedule() restaggers the sensors
+#define MAX25X05_ARRAY_SYNC_GUARD_US            (200u)
+
+// start() gives up if a sensor shows no end-of-conversion within this time (us)
+#define MAX25X05_ARRAY_START_TIMEOUT_US         (500000u)
+
+// Remaining wait (us) below which stagger() spins in wait_us() instead of sleeping
+#define MAX25X05_ARRAY_SPIN_US                  (2000u)
+
+
+class MAX25x05Array
+{
+
+public:
+    MAX25x05Array(const bool flip_sensor_pixels = false): _flip(flip_sensor_pixels)
+        {
+        };
+
+    ~MAX25x05Array();
+
+    MAX25x05Array(const MAX25x05Array &) = delete;
+    MAX25x05Array &operator=(const MAX25x05Array &) = delete;
+
+    // Creates the driver of the next sensor (left to right). Returns its index, or -1 if the array is full.
+    // The status LEDs are not connected unless given, so the sensors do not all drive LED1/LED2.
+    int add_sensor(MAX25x05_BusInterface &interface, PinName intbpin, const MAX25x05_DeviceType device,
+                   PinName rLEDpin = NC, PinName gLEDpin = NC);
+
+    // Lock shared by the sensors of one SPI bus (0 to MAX25X05_ARRAY_MAX_SENSORS-1): pass it to each of
+    // their MAX25x05_SPI interfaces, e.g. MAX25x05_SPI bus_1(spi, hz, cs_1, &sensors.bus_lock(0))
+    MAX25x05_BusLock &bus_lock(const uint8_t bus) { return _bus_locks[bus]; }
+
+    uint8_t size(void) const { return _count; }
+    MAX25x05 &sensor(const uint8_t index) { return *_sensors[index]; }
+
+    void begin(int hz);
+
+    void set_default_register_settings(void);
+
+    // Enables the INTB interrupts and staggers the conversions. frame_period_us = 0 measures the period
+    // from sensor 0. Returns false, with the interrupts disabled again, if a sensor produced no
+    // end-of-conversion, if a conversion does not fit into its slot (frame period / size(): raise SDLY or
+    // shorten the conversion), or if a sensor did not land in its slot after the restart.
+    bool start(const uint32_t frame_period_us = 0);
+
+    void stop(void);
+
+    // Checks the phase of every sensor against its slot and restaggers the array if one has drifted by
+    // more than MAX25X05_ARRAY_SYNC_GUARD_US. May block for up to three frame periods. Returns true if it
+    // resynchronised; restagger_failures() counts restaggers that did not put every sensor in its slot.
+    bool check_schedule(void);
+
+    // True once every sensor has converted since the last read_frames()
+    bool frames_ready(void) const { return (_ready_mask & all_sensors_mask()) == all_sensors_mask(); }
+    uint32_t ready_mask(void) const { return _ready_mask; }
+
+    // Reads the frames of all sensors that have converted, back-to-back
+    void read_frames(void);
+
+    const int16_t *frame(const uint8_t index) const { return _frames[index]; }
+    uint32_t timestamp_us(const uint8_t index) const { return _frame_timestamp_us[index]; }
+
+    // Copies sensor k's frame into libs[k]->pixels
+    template <class GestureLib>
+    void copy_frames(GestureLib *const libs[]) const
+    {
+        for (uint8_t k = 0; k < _count; k++) {
+            memcpy(libs[k]->pixels, _frames[k], sizeof(_frames[k]));
+        }
+    }
+
+    // Stitches the frames row by row into wide[SENSOR_ROWS][SENSOR_COLS*size()], sensor 0 on the left
+    void stitch_frames(int16_t wide[]) const;
+
+    // Stitches into a gesture library sized for the whole array, e.g. basic_gesture_lib<SENSOR_COLS*2, SENSOR_ROWS>
+    template <class GestureLib>
+    void copy_stitched_frame(GestureLib &lib) const
+    {
+        MBED_ASSERT(GestureLib::PixelArrayCols == SENSOR_COLS * _count && GestureLib::PixelArrayRows == SENSOR_ROWS);
+        stitch_frames(lib.pixels);
+    }
+
+    // Counters
+    uint32_t frame_period_us(void) const { return _frame_period_us; }
+    uint32_t slot_us(void) const { return _slot_us; }
+    uint32_t missed_conversions(void) const { return _missed_conversions; }  // INTB again before the frame was read
+    uint32_t resyncs(void) const { return _resyncs; }
+    uint32_t restagger_failures(void) const { return _restagger_failures; }
+
+private:
+    // Binds the INTB handler of one sensor to its index in the array
+    struct intb_slot {
+        MAX25x05Array *array;
+        uint8_t index;
+        void handler(void) { array->intb_handler(index); }
+    };
+
+    void intb_handler(const uint8_t index);
+    uint32_t now_us(void) const { return (uint32_t)_clock.elapsed_time().count(); }
+    void wait_until(const uint32_t deadline_us) const;
+    bool wait_for_conversions(const uint32_t mask);
+    int32_t phase_error(const uint8_t index, const uint32_t timestamp0_us, const uint32_t timestamp_us) const;
+    bool conversions_fit(void) const;
+    bool stagger(void);
+    uint32_t all_sensors_mask(void) const { return (1u << _count) - 1u; }
+
+    const bool _flip;
+    uint8_t _count = 0;
+
+    MAX25x05_BusLock _bus_locks[MAX25X05_ARRAY_MAX_SENSORS];
+    Timer _clock;
+
+    // The drivers are created in place by add_sensor(), the array owns them
+    MAX25x05 *_sensors[MAX25X05_ARRAY_MAX_SENSORS] = {};
+    alignas(MAX25x05) uint8_t _sensor_storage[MAX25X05_ARRAY_MAX_SENSORS][sizeof(MAX25x05)];
+    intb_slot _intb_slots[MAX25X05_ARRAY_MAX_SENSORS];
+
+    uint32_t _frame_period_us = 0;
+    uint32_t _slot_us = 0;
+
+    // Written by the interrupts
+    volatile uint32_t _ready_mask = 0;
+    volatile uint32_t _intb_timestamp_us[MAX25X05_ARRAY_MAX_SENSORS] = {};
+    volatile uint32_t _missed_conversions = 0;
+
+    int16_t _frames[MAX25X05_ARRAY_MAX_SENSORS][NUM_SENSOR_PIXELS] = {};
+    uint32_t _frame_timestamp_us[MAX25X05_ARRAY_MAX_SENSORS] = {};
+    uint32_t _frames_read_mask = 0;     // Sensors read since start(), the phases are known once all are set
+    uint32_t _resyncs = 0;
+    uint32_t _restagger_failures = 0;
+
+};
+
+
+#endif // __MAX25X05_ARRAY_H__
@@ -1,6 +1,19 @@
 /*
+* I2C bus interface of the MAX25x05
 *
+* Register reads are one combined transaction: the register address is written and the data read
+* back after a repeated start, without a stop in between. With DEVICE_I2C_ASYNCH the pixel read can
+* also run in the background (reg_read_async, I2C::transfer), like the SPI DMA read, but only when
+* started from a thread: I2C::transfer locks the bus mutex, which Mbed OS does not allow in interrupt
+* context. From the INTB interrupt (MAX25x05::enable_read_sensor_frames(true)) reg_read_async refuses,
+* and the driver falls back to sensorDataReadyFlag and a blocking read from the main loop.
 *
+* The CSB pin selects the device address (MAX25X05_I2C_ADDR_CSB_HIGH / _LOW), so two sensors with
+* their CSB pins driven to opposite levels can share one bus. The pin is held at its level for the
+* lifetime of the interface.
+*
+* At 100 kHz a 120 byte frame read takes about 11 ms; use MAX25X05_I2C_FAST_HZ (400 kHz) or, where the
+* sensor and the bus wiring allow it, MAX25X05_I2C_FAST_PLUS_HZ.
 */
 
 #ifndef __MAX25X05_I2C_H__
@@ -9,24 +22,37 @@
 #include "MAX25x05.h"
 //#include <cstdio>
 
+// Bus clocks: Standard mode, Fast mode (the MAX25x05 maximum) and Fast mode Plus
+#define MAX25X05_I2C_STANDARD_HZ                (100000)
+#define MAX25X05_I2C_FAST_HZ                    (400000)
+#define MAX25X05_I2C_FAST_PLUS_HZ               (1000000)
+
+// 8-bit (Mbed) device addresses selected by the CSB pin level
+#define MAX25X05_I2C_ADDR_CSB_HIGH              (0xA0)
+#define MAX25X05_I2C_ADDR_CSB_LOW               (0x9E)
+
+#define MAX25X05_I2C_MAX_BURST                  (NUM_SENSOR_PIXELS * 2)
+
 class MAX25x05_I2C: public MAX25x05_BusInterface {
 public:
     MAX25x05_I2C(I2C &i2c, int hz, PinName csbPin, uint8_t csbPinState):
-        _i2c(i2c)
+        _i2c(i2c), _csb(csbPin, csbPinState), _i2c_device_addr(device_address(csbPinState))
         {
             begin(hz);
-            DigitalOut csb(csbPin, csbPinState);
-            if (csbPinState == 1) _i2c_device_addr = 0xA0;
-            else if (csbPinState == 1) _i2c_device_addr = 0x9E;
-
         };
 
     ~MAX25x05_I2C();
 
-    void begin(int hz) {
+    void begin(int hz) {          // MAX25X05_I2C_STANDARD_HZ up to MAX25X05_I2C_FAST_PLUS_HZ
         _i2c.frequency(hz);
     }
 
+    static uint8_t device_address(const uint8_t csbPinState) {
+        return csbPinState ? MAX25X05_I2C_ADDR_CSB_HIGH : MAX25X05_I2C_ADDR_CSB_LOW;
+    }
+
+    uint8_t device_address(void) const { return _i2c_device_addr; }
+
     int reg_write(const uint8_t reg_addr, const uint8_t reg_val) {
         char data[2];
         data[0] = reg_addr;
@@ -36,17 +62,64 @@ public:
         return result;
     }
 
+    // Burst write: register address followed by the values of the following registers, one transaction
+    int reg_write_burst(const uint8_t reg_addr, const uint8_t num_bytes, const uint8_t reg_vals[])
+    {
+        if (num_bytes > MAX25X05_MAX_WRITE_BURST) return -1;
+
+        char data[1 + MAX25X05_MAX_WRITE_BURST];
+        data[0] = (char)reg_addr;
+        memcpy(&data[1], reg_vals, num_bytes);
+        return _i2c.write(_i2c_device_addr, data, 1 + num_bytes) == 0 ? 0 : -1;
+    }
+
+    // Combined read: register address, repeated start, then num_bytes. Returns -1 if the sensor did not acknowledge.
     int reg_read(const uint8_t reg_addr, const uint8_t num_bytes, uint8_t reg_vals[])
     {
         char read_addr = (char)reg_addr;
-        _i2c.write(_i2c_device_addr, &read_addr, 1);
-        _i2c.read(_i2c_device_addr, (char*)reg_vals, (int)num_bytes);
-        return 0;
+        if (_i2c.write(_i2c_device_addr, &read_addr, 1, true) != 0) {
+            _i2c.stop();
+            return -1;
+        }
+        return _i2c.read(_i2c_device_addr, (char*)reg_vals, (int)num_bytes) == 0 ? 0 : -1;
     }
 
+#if DEVICE_I2C_ASYNCH
+    // Starts the combined read in the background and returns straight away. done is called from interrupt
+    // context with 0 once reg_vals has been filled, or -1 if the transfer failed.
+    // Returns -1 in interrupt context, if a read of this interface is running or if the bus is busy with
+    // another transfer.
+    int reg_read_async(const uint8_t reg_addr, const uint8_t num_bytes, uint8_t reg_vals[], const Callback<void(int)> &done)
+    {
+        if (core_util_is_isr_active() || _async_busy || num_bytes > MAX25X05_I2C_MAX_BURST) return -1;
+
+        _async_busy = true;
+        _async_done = done;
+        _async_reg = (char)reg_addr;
+
+        int result = _i2c.transfer(_i2c_device_addr, &_async_reg, 1, (char *)reg_vals, num_bytes,
+                                   callback(this, &MAX25x05_I2C::async_read_handler), I2C_EVENT_ALL, false);
+        if (result != 0) _async_busy = false;
+        return result;
+    }
+#endif
+
 private:
     I2C         &_i2c;
-    uint32_t    _i2c_device_addr;
+    DigitalOut  _csb;
+    uint8_t     _i2c_device_addr;
+
+#if DEVICE_I2C_ASYNCH
+    void async_read_handler(int event)
+    {
+        _async_busy = false;
+        if (_async_done) _async_done((event & I2C_EVENT_TRANSFER_COMPLETE) ? 0 : -1);
+    }
+
+    volatile bool _async_busy = false;
+    char        _async_reg;
+    Callback<void(int)> _async_done;
+#endif
 
 };
 
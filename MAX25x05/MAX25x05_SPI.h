@@ -4,21 +4,39 @@
 
 #include "MAX25x05.h"
 
+// Maximum SPI clock supported by the MAX25x05
+#define MAX25X05_SPI_MAX_HZ                     (6000000)
+
+// Register address and read/write command bytes sent ahead of the data
+#define MAX25X05_SPI_HEADER_BYTES               (2u)
+#define MAX25X05_SPI_MAX_BURST                  (NUM_SENSOR_PIXELS * 2)
+
 class MAX25x05_SPI: public MAX25x05_BusInterface {
 public:
-    MAX25x05_SPI(SPI &spi, int hz, PinName cselPin):
-        _spi(spi), _csel(cselPin)
+    // Sensors on one SPI bus pass the same bus_lock, so only one transfer runs at a time; NULL for a
+    // bus of its own
+    MAX25x05_SPI(SPI &spi, int hz, PinName cselPin, MAX25x05_BusLock *bus_lock = NULL):
+        _spi(spi), _csel(cselPin, 1), _lock(bus_lock != NULL ? bus_lock : &_own_lock)
         {
             begin(hz);
         };
 
     ~MAX25x05_SPI();
     
-    void begin(int hz) {          // set default at 3MHz (3e6)
+    void begin(int hz) {          // up to MAX25X05_SPI_MAX_HZ
         _spi.frequency(hz);
+        _spi.set_default_write_value(0x00);     // Clock out 0x00 while reading, as the byte-wise reads did
+#if DEVICE_SPI_ASYNCH
+        _spi.set_dma_usage(DMA_USAGE_OPPORTUNISTIC);
+#endif
     }
 
+    // The synchronous transfers return -1 while the bus lock is taken, e.g. by an asynchronous read
+    // that owns the bus and the receive buffer until it completes
+
     int reg_write(const uint8_t reg_addr, const uint8_t reg_val) {
+        if (!_lock->try_lock()) return -1;
+
         int result = -1;
         _csel = 0;
 
@@ -27,27 +45,90 @@ public:
         result = _spi.write(reg_val);     // byte3: write byte
         _csel = 1;
 
+        _lock->unlock();
         return result;
     }
 
+    // Burst write: register address, write command, then the values of the following registers
+    int reg_write_burst(const uint8_t reg_addr, const uint8_t num_bytes, const uint8_t reg_vals[])
+    {
+        if (num_bytes > MAX25X05_MAX_WRITE_BURST || !_lock->try_lock()) return -1;
+
+        char tx[MAX25X05_SPI_HEADER_BYTES + MAX25X05_MAX_WRITE_BURST];
+        tx[0] = (char)reg_addr;
+        tx[1] = (char)0x00;      // write command 0x00
+        memcpy(&tx[MAX25X05_SPI_HEADER_BYTES], reg_vals, num_bytes);
+        _csel = 0;
+        _spi.write(tx, MAX25X05_SPI_HEADER_BYTES + num_bytes, NULL, 0);
+        _csel = 1;
+        _lock->unlock();
+        return 0;
+    }
+
+    // Burst read: one transaction of header + num_bytes instead of a blocking write per byte
     int reg_read(const uint8_t reg_addr, const uint8_t num_bytes, uint8_t reg_vals[])
     {
+        if (num_bytes > MAX25X05_SPI_MAX_BURST || !_lock->try_lock()) return -1;
+
+        const char header[MAX25X05_SPI_HEADER_BYTES] = {(char)reg_addr, (char)0x80};   // register address, read command 0x80
         _csel = 0;
-        _spi.write(reg_addr);                // byte 1: register address
-        _spi.write(0x80);                    // byte 2: read command 0x80
-        for(int i=0; i<num_bytes; i++) {
-            reg_vals[i] = _spi.write(0x00);  // byte3: read byte
-        }
+        _spi.write(header, MAX25X05_SPI_HEADER_BYTES, (char *)_rx_buf, MAX25X05_SPI_HEADER_BYTES + num_bytes);
         _csel = 1;
-    return 0;
+        memcpy(reg_vals, &_rx_buf[MAX25X05_SPI_HEADER_BYTES], num_bytes);
+        _lock->unlock();
+        return 0;
     }
 
+#if DEVICE_SPI_ASYNCH
+    // Starts a DMA/interrupt driven burst read and returns straight away. done is called from interrupt
+    // context with 0 once reg_vals has been filled, or -1 if the transfer failed (reg_vals is left as it
+    // was). Returns -1 if the bus lock is taken. The lock is held until the read has ended.
+    int reg_read_async(const uint8_t reg_addr, const uint8_t num_bytes, uint8_t reg_vals[], const Callback<void(int)> &done)
+    {
+        if (num_bytes > MAX25X05_SPI_MAX_BURST || !_lock->try_lock()) return -1;
 
+        _async_dest = reg_vals;
+        _async_len = num_bytes;
+        _async_done = done;
+        _async_header[0] = (char)reg_addr;
+        _async_header[1] = (char)0x80;
+
+        _csel = 0;
+        int result = _spi.transfer(_async_header, MAX25X05_SPI_HEADER_BYTES, (char *)_rx_buf, MAX25X05_SPI_HEADER_BYTES + num_bytes,
+                                   callback(this, &MAX25x05_SPI::async_read_handler), SPI_EVENT_COMPLETE | SPI_EVENT_ERROR);
+        if (result != 0) {
+            _csel = 1;
+            _lock->unlock();
+        }
+        return result;
+    }
+#endif
 
 private:
     SPI         &_spi;
     DigitalOut  _csel;
 
+    MAX25x05_BusLock _own_lock;
+    MAX25x05_BusLock *_lock;
+
+    uint8_t     _rx_buf[MAX25X05_SPI_HEADER_BYTES + MAX25X05_SPI_MAX_BURST];
+
+#if DEVICE_SPI_ASYNCH
+    void async_read_handler(int event)
+    {
+        _csel = 1;
+        const bool complete = (event & SPI_EVENT_COMPLETE) != 0;
+        if (complete) memcpy(_async_dest, &_rx_buf[MAX25X05_SPI_HEADER_BYTES], _async_len);
+        _lock->unlock();
+        if (_async_done) _async_done(complete ? 0 : -1);
+    }
+
+    uint8_t     *_async_dest = NULL;
+    uint8_t     _async_len = 0;
+    char        _async_header[MAX25X05_SPI_HEADER_BYTES];
+    Callback<void(int)> _async_done;
+#endif
+
 };
 
 #endif      // __MAX25X05_SPI_H__
\ No newline at end of file
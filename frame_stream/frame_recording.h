@@ -0,0 +1,218 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Raw frame recording format
+*
+* A recording is a fixed header followed by fixed size frame records, so a file can be appended to
+* while it is being captured and a reader can memory map it and index frame i directly:
+*
+*   offset                          content
+*   0                               frame_recording_header (FRAME_RECORDING_HEADER_BYTES)
+*   header_bytes + i*record_bytes   frame i: sequence (uint32), timestamp_us (uint32), cols*rows int16 pixels
+*
+* All fields are little endian (the native byte order of the MAX32620 and of x86/ARM hosts). The header
+* keeps what is needed to interpret the frames later: the device type, the frame size and the register
+* settings the sensor ran with (MAX25x05::register_settings).
+* A record cut short by a crash is ignored by readers and overwritten by the next append.
+*
+* Recordings are made on the host from the binary frame stream (frame_stream_decode --record) and
+* replayed through gesture_lib by host/tools/frame_replay.
+*/
+
+#ifndef __FRAME_RECORDING_H__
+#define __FRAME_RECORDING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FRAME_RECORDING_MAGIC                   "MX25REC1"
+#define FRAME_RECORDING_VERSION                 (1u)
+#define FRAME_RECORDING_MAX_REGISTERS           (32u)
+#define FRAME_RECORDING_HEADER_BYTES            (96u)
+
+// Frame record size for a frame of n pixels, padded to 4 bytes
+#define FRAME_RECORDING_RECORD_BYTES(n)         ((8u + 2u*(n) + 3u) & ~3u)
+
+typedef struct {
+    char magic[8];                          // FRAME_RECORDING_MAGIC, not terminated
+    uint16_t version;
+    uint16_t header_bytes;                  // Offset of the first frame record
+    uint16_t record_bytes;                  // Size of one frame record
+    uint8_t device_type;                    // MAX25x05_DeviceType
+    uint8_t cols;
+    uint8_t rows;
+    uint8_t num_registers;
+    uint8_t reserved[6];
+    uint64_t start_time;                    // Seconds since 1970 when the recording started, 0 if unknown
+    uint8_t registers[FRAME_RECORDING_MAX_REGISTERS][2];    // {register, value} in write order
+} frame_recording_header;
+
+static_assert(sizeof(frame_recording_header) == FRAME_RECORDING_HEADER_BYTES, "frame_recording_header layout");
+
+inline void frame_recording_init_header(frame_recording_header &header, const uint8_t device_type, const uint8_t cols, const uint8_t rows,
+                                        const uint8_t registers[][2], const uint8_t num_registers, const uint64_t start_time)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_RECORDING_MAGIC, sizeof(header.magic));
+    header.version = FRAME_RECORDING_VERSION;
+    header.header_bytes = FRAME_RECORDING_HEADER_BYTES;
+    header.record_bytes = FRAME_RECORDING_RECORD_BYTES(cols * rows);
+    header.device_type = device_type;
+    header.cols = cols;
+    header.rows = rows;
+    header.num_registers = num_registers <= FRAME_RECORDING_MAX_REGISTERS ? num_registers : FRAME_RECORDING_MAX_REGISTERS;
+    memcpy(header.registers, registers, header.num_registers * 2);
+    header.start_time = start_time;
+}
+
+inline bool frame_recording_check_header(const frame_recording_header &header)
+{
+    return memcmp(header.magic, FRAME_RECORDING_MAGIC, sizeof(header.magic)) == 0 && header.version == FRAME_RECORDING_VERSION &&
+           header.header_bytes >= FRAME_RECORDING_HEADER_BYTES && header.cols > 0 && header.rows > 0 &&
+           header.record_bytes >= FRAME_RECORDING_RECORD_BYTES(header.cols * header.rows) &&
+           header.num_registers <= FRAME_RECORDING_MAX_REGISTERS;
+}
+
+
+/*
+* Appends frames to a recording file (stdio, so it works on the host and on an Mbed file system)
+*/
+class frame_recording_writer
+{
+
+public:
+    ~frame_recording_writer() { close(); }
+
+    // Creates the file, or appends to it if it already holds a recording with the same frame size
+    // and register settings. Returns false if the file cannot be opened or does not match.
+    bool open(const char *path, const frame_recording_header &header)
+    {
+        close();
+        _header = header;
+
+        _file = fopen(path, "r+b");
+        if (_file != NULL) {
+            frame_recording_header existing;
+            if (fread(&existing, sizeof(existing), 1, _file) != 1 || !frame_recording_check_header(existing) ||
+                existing.cols != header.cols || existing.rows != header.rows || existing.num_registers != header.num_registers ||
+                memcmp(existing.registers, header.registers, header.num_registers * 2) != 0) {
+                close();
+                return false;
+            }
+            _header = existing;
+            fseek(_file, 0, SEEK_END);
+            _frames = (uint32_t)((ftell(_file) - existing.header_bytes) / existing.record_bytes);
+        }
+        else {
+            _file = fopen(path, "wb");
+            if (_file == NULL || fwrite(&_header, sizeof(_header), 1, _file) != 1) {
+                close();
+                return false;
+            }
+            _frames = 0;
+        }
+        return fseek(_file, _header.header_bytes + (long)_frames * _header.record_bytes, SEEK_SET) == 0;
+    }
+
+    bool append(const uint32_t sequence, const uint32_t timestamp_us, const int16_t pixels[])
+    {
+        const size_t pixel_bytes = (size_t)_header.cols * _header.rows * sizeof(int16_t);
+
+        if (_file == NULL) return false;
+        if (fwrite(&sequence, 4, 1, _file) != 1 || fwrite(&timestamp_us, 4, 1, _file) != 1 ||
+            fwrite(pixels, pixel_bytes, 1, _file) != 1) {
+            return false;
+        }
+        for (size_t i = 8 + pixel_bytes; i < _header.record_bytes; i++) fputc(0, _file);
+        _frames++;
+        return true;
+    }
+
+    void close(void)
+    {
+        if (_file != NULL) fclose(_file);
+        _file = NULL;
+    }
+
+    uint32_t frames(void) const { return _frames; }
+
+private:
+    FILE *_file = NULL;
+    frame_recording_header _header;
+    uint32_t _frames = 0;
+
+};
+
+
+/*
+* Read access to a recording held in memory, e.g. a memory mapped file
+*/
+class frame_recording_view
+{
+
+public:
+    // Returns false if data does not start with a valid recording header
+    bool attach(const void *data, const size_t size)
+    {
+        _data = (const uint8_t *)data;
+        if (size < sizeof(frame_recording_header) || !frame_recording_check_header(header()) || size < header().header_bytes) {
+            _frames = 0;
+            return false;
+        }
+        _frames = (size - header().header_bytes) / header().record_bytes;
+        return true;
+    }
+
+    const frame_recording_header &header(void) const { return *(const frame_recording_header *)_data; }
+    size_t frames(void) const { return _frames; }
+
+    uint32_t sequence(const size_t i) const { return read_u32(record(i)); }
+    uint32_t timestamp_us(const size_t i) const { return read_u32(record(i) + 4); }
+    const int16_t *pixels(const size_t i) const { return (const int16_t *)(record(i) + 8); }
+
+private:
+    const uint8_t *record(const size_t i) const { return _data + header().header_bytes + i * header().record_bytes; }
+    static uint32_t read_u32(const uint8_t *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+    const uint8_t *_data = NULL;
+    size_t _frames = 0;
+
+};
+
+
+#endif // __FRAME_RECORDING_H__
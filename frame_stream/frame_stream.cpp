@@ -0,0 +1,369 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Binary frame stream: COBS framed, CRC checked sensor frames with optional delta/zig-zag encoding
+*/
+
+#include "frame_stream.h"
+
+#include <string.h>
+
+/*
+* CRC-16/CCITT-FALSE, a nibble at a time to keep the table small on the MCU
+*/
+uint16_t frame_stream_crc16(const uint8_t data[], const size_t length)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc = (uint16_t)(crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (uint16_t)(crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+static inline void put_u32(uint8_t *p, const uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t frame_stream_encoder::encode(const uint32_t sequence, const uint32_t timestamp_us, const int16_t pixels[], const uint8_t num_pixels, uint8_t out[])
+{
+    if (num_pixels > FRAME_STREAM_MAX_PIXELS) return 0;
+
+    // Delta packets need the previous packet to have the same size
+    const bool keyframe = !_delta || _since_keyframe >= _keyframe_interval || num_pixels != _prev_num_pixels;
+
+    uint8_t *p = _packet;
+    *p++ = (uint8_t)((FRAME_STREAM_VERSION << 4) | (keyframe ? 0 : FRAME_STREAM_FLAG_DELTA));
+    *p++ = _count++;
+    *p++ = num_pixels;
+    put_u32(p, sequence);
+    put_u32(p + 4, timestamp_us);
+    p += 8;
+
+    if (keyframe) {
+        for (uint8_t i = 0; i < num_pixels; i++) {
+            *p++ = (uint8_t)pixels[i];
+            *p++ = (uint8_t)((uint16_t)pixels[i] >> 8);
+        }
+        _since_keyframe = 0;
+    }
+    else {
+        for (uint8_t i = 0; i < num_pixels; i++) {
+            const int32_t diff = (int32_t)pixels[i] - (int32_t)_prev_pixels[i];
+            uint32_t zigzag = ((uint32_t)diff << 1) ^ (uint32_t)(diff >> 31);
+            while (zigzag >= 0x80) {
+                *p++ = (uint8_t)(zigzag | 0x80);
+                zigzag >>= 7;
+            }
+            *p++ = (uint8_t)zigzag;
+        }
+    }
+    _since_keyframe++;
+
+    if (_delta) {
+        memcpy(_prev_pixels, pixels, num_pixels * sizeof(int16_t));
+        _prev_num_pixels = num_pixels;
+    }
+
+    return finish_packet(p, out);
+}
+
+size_t frame_stream_encoder::encode_info(const frame_stream_info &info, uint8_t out[])
+{
+    const uint8_t num_registers = info.num_registers <= FRAME_STREAM_MAX_REGISTERS ? info.num_registers : FRAME_STREAM_MAX_REGISTERS;
+
+    uint8_t *p = _packet;
+    *p++ = (uint8_t)((FRAME_STREAM_VERSION << 4) | FRAME_STREAM_FLAG_INFO);
+    *p++ = _count++;
+    *p++ = 0;
+    put_u32(p, 0);
+    put_u32(p + 4, 0);
+    p += 8;
+
+    *p++ = info.device_type;
+    *p++ = info.cols;
+    *p++ = info.rows;
+    *p++ = num_registers;
+    memcpy(p, info.registers, num_registers * 2);
+    p += num_registers * 2;
+
+    return finish_packet(p, out);
+}
+
+size_t frame_stream_encoder::encode_profile(const frame_stream_profile &profile, uint8_t out[])
+{
+    const uint8_t num_buckets = profile.num_buckets <= FRAME_STREAM_MAX_PROFILE_BUCKETS ? profile.num_buckets : FRAME_STREAM_MAX_PROFILE_BUCKETS;
+    size_t name_length = strlen(profile.name);
+    if (name_length > FRAME_STREAM_MAX_STAGE_NAME) name_length = FRAME_STREAM_MAX_STAGE_NAME;
+
+    uint8_t *p = _packet;
+    *p++ = (uint8_t)((FRAME_STREAM_VERSION << 4) | FRAME_STREAM_FLAG_PROFILE);
+    *p++ = _count++;
+    *p++ = 0;
+    put_u32(p, 0);
+    put_u32(p + 4, 0);
+    p += 8;
+
+    *p++ = profile.stage;
+    *p++ = (uint8_t)name_length;
+    memcpy(p, profile.name, name_length);
+    p += name_length;
+    put_u32(p, profile.ticks_per_us);
+    put_u32(p + 4, profile.count);
+    put_u32(p + 8, profile.min);
+    put_u32(p + 12, profile.avg);
+    put_u32(p + 16, profile.max);
+    p += 20;
+    *p++ = num_buckets;
+    for (uint8_t b = 0; b < num_buckets; b++, p += 4) put_u32(p, profile.buckets[b]);
+
+    return finish_packet(p, out);
+}
+
+/*
+* Appends the CRC to the packet in _packet[] and COBS encodes it into out[]
+*/
+size_t frame_stream_encoder::finish_packet(uint8_t *end, uint8_t out[])
+{
+    uint8_t *p = end;
+    const uint16_t crc = frame_stream_crc16(_packet, p - _packet);
+    *p++ = (uint8_t)crc;
+    *p++ = (uint8_t)(crc >> 8);
+
+    // COBS: every zero is replaced by the distance to the next one, blocks are at most 254 bytes
+    const size_t length = p - _packet;
+    size_t code_index = 0;
+    size_t n = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (_packet[i] == 0) {
+            out[code_index] = code;
+            code_index = n++;
+            code = 1;
+        }
+        else {
+            out[n++] = _packet[i];
+            if (++code == 0xFF) {
+                out[code_index] = code;
+                code_index = n++;
+                code = 1;
+            }
+        }
+    }
+    out[code_index] = code;
+    out[n++] = 0x00;
+    return n;
+}
+
+frame_stream_decoder::Status frame_stream_decoder::push(const uint8_t byte)
+{
+    if (byte != 0x00) {
+        if (_length < sizeof(_buf)) _buf[_length++] = byte;
+        else _overflow = true;
+        return FRAME_NONE;
+    }
+
+    // Delimiter: decode what was collected since the previous one
+    Status status = FRAME_NONE;
+    if (_overflow) {
+        _format_errors++;
+        status = FRAME_FORMAT_ERROR;
+    }
+    else if (_length > 0) {
+        status = decode_packet();
+    }
+    _length = 0;
+    _overflow = false;
+    return status;
+}
+
+frame_stream_decoder::Status frame_stream_decoder::decode_packet()
+{
+    // COBS decode in place, the output never overtakes the input
+    size_t in = 0, out = 0;
+    while (in < _length) {
+        const uint8_t code = _buf[in++];
+        if (in + code - 1 > _length) {
+            _format_errors++;
+            return FRAME_FORMAT_ERROR;
+        }
+        for (uint8_t i = 1; i < code; i++) _buf[out++] = _buf[in++];
+        if (code != 0xFF && in < _length) _buf[out++] = 0x00;
+    }
+
+    const uint8_t *packet = _buf;
+    if (out < FRAME_STREAM_HEADER_BYTES + FRAME_STREAM_CRC_BYTES || (packet[0] >> 4) != FRAME_STREAM_VERSION) {
+        _format_errors++;
+        return FRAME_FORMAT_ERROR;
+    }
+
+    const size_t crc_offset = out - FRAME_STREAM_CRC_BYTES;
+    const uint16_t crc = (uint16_t)(packet[crc_offset] | (packet[crc_offset + 1] << 8));
+    if (crc != frame_stream_crc16(packet, crc_offset)) {
+        _crc_errors++;
+        return FRAME_CRC_ERROR;
+    }
+
+    const bool delta = (packet[0] & FRAME_STREAM_FLAG_DELTA) != 0;
+    const uint8_t count = packet[1];
+    const uint8_t num_pixels = packet[2];
+    if (num_pixels > FRAME_STREAM_MAX_PIXELS) {
+        _format_errors++;
+        return FRAME_FORMAT_ERROR;
+    }
+
+    bool lost = false;
+    if (_have_count && count != (uint8_t)(_count + 1)) {
+        _lost_packets += (uint8_t)(count - _count - 1);
+        lost = true;
+    }
+    _have_count = true;
+    _count = count;
+
+    if (packet[0] & (FRAME_STREAM_FLAG_INFO | FRAME_STREAM_FLAG_PROFILE)) {
+        // A lost packet before the info packet may still have been the delta reference
+        if (lost) _have_reference = false;
+        if (packet[0] & FRAME_STREAM_FLAG_PROFILE) return decode_profile(packet + FRAME_STREAM_HEADER_BYTES, crc_offset - FRAME_STREAM_HEADER_BYTES);
+        return decode_info(packet + FRAME_STREAM_HEADER_BYTES, crc_offset - FRAME_STREAM_HEADER_BYTES);
+    }
+
+    if (delta && (lost || !_have_reference || num_pixels != _frame.num_pixels)) {
+        _have_reference = false;
+        return FRAME_NEED_KEYFRAME;
+    }
+
+    // The pixels are decoded over the previous frame, which is the delta reference
+    const uint8_t *p = packet + FRAME_STREAM_HEADER_BYTES;
+    const uint8_t *end = packet + crc_offset;
+    if (delta) {
+        for (uint8_t i = 0; i < num_pixels; i++) {
+            uint32_t zigzag = 0;
+            for (uint8_t shift = 0; ; shift += 7) {
+                if (p == end || shift > 14) {
+                    _have_reference = false;
+                    _format_errors++;
+                    return FRAME_FORMAT_ERROR;
+                }
+                const uint8_t b = *p++;
+                zigzag |= (uint32_t)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0) break;
+            }
+            const int32_t diff = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            _frame.pixels[i] = (int16_t)(_frame.pixels[i] + diff);
+        }
+    }
+    else {
+        if (end - p != 2 * num_pixels) {
+            _have_reference = false;
+            _format_errors++;
+            return FRAME_FORMAT_ERROR;
+        }
+        for (uint8_t i = 0; i < num_pixels; i++, p += 2) {
+            _frame.pixels[i] = (int16_t)(p[0] | (p[1] << 8));
+        }
+    }
+    if (p != end) {
+        _have_reference = false;
+        _format_errors++;
+        return FRAME_FORMAT_ERROR;
+    }
+
+    _frame.sequence = get_u32(packet + 3);
+    _frame.timestamp_us = get_u32(packet + 7);
+    _frame.num_pixels = num_pixels;
+    _frame.keyframe = !delta;
+    _have_reference = true;
+    _frames_decoded++;
+    return FRAME_OK;
+}
+
+frame_stream_decoder::Status frame_stream_decoder::decode_info(const uint8_t body[], const size_t length)
+{
+    if (length < 4 || body[3] > FRAME_STREAM_MAX_REGISTERS || length != 4u + body[3] * 2u) {
+        _format_errors++;
+        return FRAME_FORMAT_ERROR;
+    }
+
+    _info.device_type = body[0];
+    _info.cols = body[1];
+    _info.rows = body[2];
+    _info.num_registers = body[3];
+    memcpy(_info.registers, body + 4, body[3] * 2);
+    _have_info = true;
+    return FRAME_INFO;
+}
+
+frame_stream_decoder::Status frame_stream_decoder::decode_profile(const uint8_t body[], const size_t length)
+{
+    if (length < 2 || body[1] > FRAME_STREAM_MAX_STAGE_NAME || length < 2u + body[1] + 21u) {
+        _format_errors++;
+        return FRAME_FORMAT_ERROR;
+    }
+    const uint8_t name_length = body[1];
+    const uint8_t *p = body + 2 + name_length;
+    const uint8_t num_buckets = p[20];
+    if (num_buckets > FRAME_STREAM_MAX_PROFILE_BUCKETS || length != 2u + name_length + 21u + num_buckets * 4u) {
+        _format_errors++;
+        return FRAME_FORMAT_ERROR;
+    }
+
+    _profile.stage = body[0];
+    memcpy(_profile.name, body + 2, name_length);
+    _profile.name[name_length] = '\0';
+    _profile.ticks_per_us = get_u32(p);
+    _profile.count = get_u32(p + 4);
+    _profile.min = get_u32(p + 8);
+    _profile.avg = get_u32(p + 12);
+    _profile.max = get_u32(p + 16);
+    _profile.num_buckets = num_buckets;
+    p += 21;
+    for (uint8_t b = 0; b < num_buckets; b++, p += 4) _profile.buckets[b] = get_u32(p);
+    return FRAME_PROFILE;
+}
@@ -0,0 +1,245 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Binary frame stream: compact framing of sensor frames for the serial/USB link to the host
+*
+* Replaces the ASCII CSV lines read by the Processing viewer. Each frame is one packet:
+*
+*   offset  size  field
+*   0       1     flags: version in bits [7:4], FRAME_STREAM_FLAG_DELTA
+*   1       1     stream count, +1 per packet (mod 256), lets the decoder detect lost packets
+*   2       1     number of pixels
+*   3       4     sequence number (little endian)
+*   7       4     timestamp, us (little endian)
+*   11      -     pixels: int16 little endian, or with FRAME_STREAM_FLAG_DELTA the difference to the
+*                 same pixel of the previous packet, zig-zag mapped and written as a 1-3 byte varint
+*   end-2   2     CRC-16/CCITT-FALSE of all the bytes above (little endian)
+*
+* Info packets (FRAME_STREAM_FLAG_INFO, no pixels) describe the source instead: device type, frame
+* size and the sensor register settings, as stored with recordings (frame_recording.h). The firmware
+* sends one every FRAME_STREAM_INFO_INTERVAL frames so a receiver that connects late still gets it.
+* Profile packets (FRAME_STREAM_FLAG_PROFILE, no pixels) carry the timing statistics of one processing
+* stage (stage_profiler.h) when the firmware is built with GESTURE_PROFILE.
+*
+* The packet is COBS encoded and terminated by a 0x00 byte, so a receiver that starts mid-stream or
+* loses bytes resynchronises at the next zero. Delta packets only decode when the previous packet was
+* received; the encoder sends a full (key) frame every keyframe_interval packets so a receiver
+* recovers quickly. A 60 pixel key frame is 135 bytes on the wire, a delta frame of a still scene 75.
+*
+* The encoder and decoder have no Mbed dependencies: the firmware uses the encoder and the host
+* tools link the same file for the decoder.
+*/
+
+#ifndef __FRAME_STREAM_H__
+#define __FRAME_STREAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_STREAM_VERSION                    (1u)
+#define FRAME_STREAM_FLAG_DELTA                 (0x01u)
+#define FRAME_STREAM_FLAG_INFO                  (0x02u)
+#define FRAME_STREAM_FLAG_PROFILE               (0x04u)
+
+#define FRAME_STREAM_HEADER_BYTES               (11u)
+#define FRAME_STREAM_CRC_BYTES                  (2u)
+
+// Largest frame carried by the stream: four stitched sensors (MAX25x05Array)
+#define FRAME_STREAM_MAX_PIXELS                 (240u)
+
+// Key frame sent at least this often when delta encoding is enabled
+#define FRAME_STREAM_KEYFRAME_INTERVAL          (32u)
+
+// Register settings carried by an info packet
+#define FRAME_STREAM_MAX_REGISTERS              (32u)
+#define FRAME_STREAM_INFO_INTERVAL              (128u)
+
+// Stage statistics carried by a profile packet
+#define FRAME_STREAM_MAX_STAGE_NAME             (15u)
+#define FRAME_STREAM_MAX_PROFILE_BUCKETS        (24u)
+
+// Worst case packet size before and after COBS (including the 0x00 delimiter) for n pixels
+#define FRAME_STREAM_MAX_PACKET_BYTES(n)        (FRAME_STREAM_HEADER_BYTES + 3u*(n) + FRAME_STREAM_CRC_BYTES)
+#define FRAME_STREAM_MAX_ENCODED_BYTES(n)       (FRAME_STREAM_MAX_PACKET_BYTES(n) + FRAME_STREAM_MAX_PACKET_BYTES(n)/254u + 2u)
+
+
+// One decoded frame
+typedef struct {
+    uint32_t sequence;
+    uint32_t timestamp_us;
+    uint8_t num_pixels;
+    bool keyframe;
+    int16_t pixels[FRAME_STREAM_MAX_PIXELS];
+} frame_stream_frame;
+
+// Source description carried by an info packet
+typedef struct {
+    uint8_t device_type;                    // MAX25x05_DeviceType
+    uint8_t cols;
+    uint8_t rows;
+    uint8_t num_registers;
+    uint8_t registers[FRAME_STREAM_MAX_REGISTERS][2];       // {register, value} in write order
+} frame_stream_info;
+
+// Timing statistics of one processing stage carried by a profile packet
+typedef struct {
+    uint8_t stage;
+    char name[FRAME_STREAM_MAX_STAGE_NAME + 1];
+    uint32_t ticks_per_us;                  // Durations are in ticks: CPU cycles on the target
+    uint32_t count;
+    uint32_t min;
+    uint32_t avg;
+    uint32_t max;
+    uint8_t num_buckets;
+    uint32_t buckets[FRAME_STREAM_MAX_PROFILE_BUCKETS];    // Bucket b: durations below 2^b ticks (see stage_profiler.h)
+} frame_stream_profile;
+
+
+class frame_stream_encoder
+{
+
+public:
+    frame_stream_encoder(const bool delta = false, const uint16_t keyframe_interval = FRAME_STREAM_KEYFRAME_INTERVAL):
+        _delta(delta), _keyframe_interval(keyframe_interval)
+        {
+        };
+
+    // Encodes one frame into out[], which must hold FRAME_STREAM_MAX_ENCODED_BYTES(num_pixels) bytes.
+    // Returns the number of bytes to send, including the trailing 0x00 delimiter (0 if num_pixels is too large).
+    size_t encode(const uint32_t sequence, const uint32_t timestamp_us, const int16_t pixels[], const uint8_t num_pixels, uint8_t out[]);
+
+    // Encodes an info packet into out[] (FRAME_STREAM_MAX_ENCODED_BYTES(NUM_SENSOR_PIXELS) is enough).
+    // Does not affect delta encoding. Returns the number of bytes to send.
+    size_t encode_info(const frame_stream_info &info, uint8_t out[]);
+
+    // Encodes a profile packet into out[] (FRAME_STREAM_MAX_ENCODED_BYTES(NUM_SENSOR_PIXELS) is enough).
+    // Does not affect delta encoding. Returns the number of bytes to send.
+    size_t encode_profile(const frame_stream_profile &profile, uint8_t out[]);
+
+    // The next packet is sent as a key frame
+    void reset(void) { _since_keyframe = _keyframe_interval; }
+
+private:
+    size_t finish_packet(uint8_t *end, uint8_t out[]);
+
+    const bool _delta;
+    const uint16_t _keyframe_interval;
+    uint16_t _since_keyframe = FRAME_STREAM_KEYFRAME_INTERVAL;
+    uint8_t _count = 0;
+    uint8_t _prev_num_pixels = 0;
+    int16_t _prev_pixels[FRAME_STREAM_MAX_PIXELS];
+    uint8_t _packet[FRAME_STREAM_MAX_PACKET_BYTES(FRAME_STREAM_MAX_PIXELS)];
+
+};
+
+
+class frame_stream_decoder
+{
+
+public:
+    enum Status {
+        FRAME_NONE,                 // No complete packet yet
+        FRAME_OK,                   // frame() holds a new frame
+        FRAME_INFO,                 // info() holds a new source description
+        FRAME_PROFILE,              // profile() holds new stage statistics
+        FRAME_CRC_ERROR,
+        FRAME_FORMAT_ERROR,         // Bad COBS, version, length or a packet longer than the buffer
+        FRAME_NEED_KEYFRAME         // Delta packet without its reference frame, waiting for the next key frame
+    };
+
+    // Feeds one received byte
+    Status push(const uint8_t byte);
+
+    // Feeds a block of received bytes and calls on_frame(const frame_stream_frame &) for every decoded frame.
+    // Returns the number of frames decoded.
+    template <class F>
+    size_t feed(const uint8_t data[], const size_t length, F on_frame)
+    {
+        size_t frames = 0;
+        for (size_t i = 0; i < length; i++) {
+            if (push(data[i]) == FRAME_OK) {
+                on_frame(_frame);
+                frames++;
+            }
+        }
+        return frames;
+    }
+
+    const frame_stream_frame &frame(void) const { return _frame; }
+
+    // Latest info packet, valid once has_info() is set
+    bool has_info(void) const { return _have_info; }
+    const frame_stream_info &info(void) const { return _info; }
+
+    // Latest profile packet, valid after push() returned FRAME_PROFILE
+    const frame_stream_profile &profile(void) const { return _profile; }
+
+    // Counters
+    uint32_t frames_decoded(void) const { return _frames_decoded; }
+    uint32_t crc_errors(void) const { return _crc_errors; }
+    uint32_t format_errors(void) const { return _format_errors; }
+    uint32_t lost_packets(void) const { return _lost_packets; }       // From gaps in the stream count
+
+private:
+    Status decode_packet(void);
+    Status decode_info(const uint8_t body[], const size_t length);
+    Status decode_profile(const uint8_t body[], const size_t length);
+
+    uint8_t _buf[FRAME_STREAM_MAX_ENCODED_BYTES(FRAME_STREAM_MAX_PIXELS)];
+    size_t _length = 0;
+    bool _overflow = false;
+
+    frame_stream_frame _frame = {};
+    frame_stream_info _info = {};
+    frame_stream_profile _profile = {};
+    bool _have_info = false;
+    bool _have_reference = false;
+    bool _have_count = false;
+    uint8_t _count = 0;
+
+    uint32_t _frames_decoded = 0;
+    uint32_t _crc_errors = 0;
+    uint32_t _format_errors = 0;
+    uint32_t _lost_packets = 0;
+
+};
+
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+uint16_t frame_stream_crc16(const uint8_t data[], const size_t length);
+
+
+#endif // __FRAME_STREAM_H__
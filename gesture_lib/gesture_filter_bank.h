@@ -0,0 +1,361 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Per pixel temporal filters that can replace the 3 frame window filter of basic_gesture_lib
+* (setTemporalFilter). Every filter works on the frame history of the gesture_lib, so the FIR taps and
+* the biquad input terms are read from the frames already held there instead of being copied. An FIR
+* with more taps than the history holds (GESTURE_HISTORY_DEPTH) keeps its own delay line of that many
+* frames instead, which costs a copy of each frame and 2*N bytes per tap.
+*
+* Each filter comes in two forms with the same arithmetic:
+*  - coefficients as template arguments (gesture_fir_filter, gesture_biquad_filter, gesture_ema_filter):
+*    they are compile time constants, so the multiplies are by immediates, which the compiler turns
+*    into shifts and adds where it pays, and the tap loop unrolls. gesture_ema_filter is a pure shift.
+*  - coefficients set at run time from floats (the _runtime classes), for tuning. With the same
+*    quantised coefficients they give bit-identical output to the template form.
+*
+* The arithmetic is integer only: FIR and EMA coefficients are Q15, biquad coefficients Q14, the IIR
+* state carries GESTURE_FILTER_STATE_BITS fraction bits so small steps are not lost, and the outputs
+* are rounded and saturated to int16.
+*
+* Example, a 3 tap binomial low pass (1/4, 1/2, 1/4) in place of the window filter:
+*   static gesture_fir_filter<gesture_lib::PixelArraySize, GESTURE_FLOAT_TO_Q15(0.25F),
+*                             GESTURE_FLOAT_TO_Q15(0.5F), GESTURE_FLOAT_TO_Q15(0.25F)> fir;
+*   gesture_1.setTemporalFilter(&fir);
+*/
+
+#ifndef __GESTURE_FILTER_BANK_H__
+#define __GESTURE_FILTER_BANK_H__
+
+#include <cstdint>
+#include "gesture_frame_history.h"
+
+// Included from gesture_lib.h once GESTURE_HISTORY_DEPTH and the Q15 macros are defined
+
+#define GESTURE_FLOAT_TO_Q15_SIGNED(x)  ((int32_t)((x) * 32768.0F + ((x) < 0 ? -0.5F : 0.5F)))
+#define GESTURE_Q14_ONE                 (16384)
+#define GESTURE_FLOAT_TO_Q14(x)         ((int32_t)((x) * 16384.0F + ((x) < 0 ? -0.5F : 0.5F)))
+
+// Fraction bits of the biquad and EMA state
+#define GESTURE_FILTER_STATE_BITS       (8)
+
+static inline int16_t gesture_filter_saturate(const int64_t v)
+{
+    return (int16_t)(v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+}
+
+
+/*
+* Interface basic_gesture_lib calls in place of the window filter, once per frame
+*/
+template <uint16_t N>
+class gesture_temporal_filter
+{
+
+public:
+    typedef gesture_frame_history<N, GESTURE_HISTORY_DEPTH> History;
+
+    virtual ~gesture_temporal_filter() {}
+
+    // Filters history.newest(0), the frame just pushed, into out[]. Returns the largest output pixel.
+    virtual int filter(const History &history, int16_t *out) = 0;
+
+    // Starts the filter in the steady state for frame (history is filled with it), without output
+    virtual void reset(const int16_t *frame) = 0;
+
+};
+
+
+/*
+* N-tap FIR: out = sum c[k] * newest(k), coefficients in Q15. The taps reach back as far as the history.
+* The sum is 64 bit, so coefficients of any magnitude (gain above 1, differentiators) saturate the
+* output instead of overflowing.
+*/
+template <uint16_t N, uint16_t Taps, uint16_t Depth>
+static inline int gesture_fir_q15(const gesture_frame_history<N, Depth> &history, const int32_t *c, int16_t *out)
+{
+    static_assert(Taps >= 1 && Taps <= Depth, "FIR taps must fit in the frame history");
+    const int16_t *x[Taps];
+    for (uint16_t k = 0; k < Taps; k++) x[k] = history.newest(k);
+
+    int max_pixel = -99999;
+    for (uint16_t i = 0; i < N; i++) {
+        int64_t acc = 1 << 14;
+        for (uint16_t k = 0; k < Taps; k++) acc += (int64_t)c[k] * x[k][i];
+        out[i] = gesture_filter_saturate(acc >> 15);
+        if (out[i] > max_pixel) max_pixel = out[i];
+    }
+    return max_pixel;
+}
+
+/*
+* Where the FIR taps are read from: the gesture_lib frame history if it is deep enough, otherwise a delay
+* line of Taps frames that the newest frame is copied into. The delay line starts filled with the first
+* frame it sees (or the reset frame), so the filter starts in the steady state like the history does.
+*/
+template <uint16_t N, uint16_t Taps, bool OwnDelayLine = (Taps > GESTURE_HISTORY_DEPTH)>
+class gesture_fir_taps
+{
+
+protected:
+    int fir(const typename gesture_temporal_filter<N>::History &history, const int32_t *c, int16_t *out)
+    {
+        return gesture_fir_q15<N, Taps>(history, c, out);
+    }
+
+    void start(const int16_t * /*frame*/) {}
+
+};
+
+template <uint16_t N, uint16_t Taps>
+class gesture_fir_taps<N, Taps, true>
+{
+
+protected:
+    int fir(const typename gesture_temporal_filter<N>::History &history, const int32_t *c, int16_t *out)
+    {
+        if (_delay_line.count() == 0) _delay_line.fill(history.newest(0));
+        else _delay_line.push(history.newest(0));
+        return gesture_fir_q15<N, Taps>(_delay_line, c, out);
+    }
+
+    void start(const int16_t *frame) { _delay_line.fill(frame); }
+
+private:
+    gesture_frame_history<N, Taps> _delay_line;
+
+};
+
+template <uint16_t N, int32_t... CoeffsQ15>
+class gesture_fir_filter : public gesture_temporal_filter<N>, private gesture_fir_taps<N, sizeof...(CoeffsQ15)>
+{
+
+public:
+    static constexpr uint16_t taps = sizeof...(CoeffsQ15);
+
+    int filter(const typename gesture_temporal_filter<N>::History &history, int16_t *out) override
+    {
+        static constexpr int32_t c[taps] = {CoeffsQ15...};
+        return this->fir(history, c, out);
+    }
+
+    void reset(const int16_t *frame) override { this->start(frame); }
+
+};
+
+template <uint16_t N, uint16_t MaxTaps = GESTURE_HISTORY_DEPTH>
+class gesture_fir_filter_runtime : public gesture_temporal_filter<N>, private gesture_fir_taps<N, MaxTaps>
+{
+
+public:
+    // Coefficient k applies to the frame k frames back; unused taps are 0. Returns -1 if taps > MaxTaps.
+    int set_coefficients(const float coeffs[], const uint16_t taps)
+    {
+        if (taps > MaxTaps) return -1;
+        for (uint16_t k = 0; k < MaxTaps; k++) _c[k] = k < taps ? GESTURE_FLOAT_TO_Q15_SIGNED(coeffs[k]) : 0;
+        return 0;
+    }
+
+    int filter(const typename gesture_temporal_filter<N>::History &history, int16_t *out) override
+    {
+        return this->fir(history, _c, out);
+    }
+
+    void reset(const int16_t *frame) override { this->start(frame); }
+
+private:
+    int32_t _c[MaxTaps] = {};
+
+};
+
+
+/*
+* Biquad IIR, direct form I: y = b0*x0 + b1*x1 + b2*x2 - a1*y1 - a2*y2 with coefficients in Q14
+* (|coefficient| < 2). x1 and x2 are the previous frames of the history, y1 and y2 per pixel state.
+*/
+template <uint16_t N>
+class gesture_biquad_state
+{
+
+protected:
+    int biquad(const gesture_frame_history<N, GESTURE_HISTORY_DEPTH> &history, const int32_t b0, const int32_t b1, const int32_t b2,
+               const int32_t a1, const int32_t a2, int16_t *out)
+    {
+        const int16_t *x0 = history.newest(0);
+        const int16_t *x1 = history.newest(1);
+        const int16_t *x2 = history.newest(2);
+
+        int max_pixel = -99999;
+        for (uint16_t i = 0; i < N; i++) {
+            const int64_t fir = ((int64_t)b0 * x0[i] + (int64_t)b1 * x1[i] + (int64_t)b2 * x2[i]) * (1 << GESTURE_FILTER_STATE_BITS);
+            const int64_t acc = fir - (int64_t)a1 * _y1[i] - (int64_t)a2 * _y2[i] + (1 << 13);
+            const int32_t y = (int32_t)(acc >> 14);
+            _y2[i] = _y1[i];
+            _y1[i] = y;
+            out[i] = gesture_filter_saturate((y + (1 << (GESTURE_FILTER_STATE_BITS - 1))) >> GESTURE_FILTER_STATE_BITS);
+            if (out[i] > max_pixel) max_pixel = out[i];
+        }
+        return max_pixel;
+    }
+
+    // y1 = y2 = the steady state output for a constant input frame: DC gain (b0+b1+b2)/(1+a1+a2)
+    void start(const int16_t *frame, const int32_t b_sum, const int32_t a_sum)
+    {
+        const int32_t den = GESTURE_Q14_ONE + a_sum;
+        for (uint16_t i = 0; i < N; i++) {
+            const int32_t y = den != 0 ? (int32_t)(((int64_t)frame[i] * b_sum * (1 << GESTURE_FILTER_STATE_BITS)) / den)
+                                       : frame[i] * (1 << GESTURE_FILTER_STATE_BITS);
+            _y1[i] = _y2[i] = y;
+        }
+    }
+
+    int32_t _y1[N] = {};
+    int32_t _y2[N] = {};
+
+};
+
+template <uint16_t N, int32_t B0, int32_t B1, int32_t B2, int32_t A1, int32_t A2>
+class gesture_biquad_filter : public gesture_temporal_filter<N>, private gesture_biquad_state<N>
+{
+
+public:
+    static_assert(GESTURE_HISTORY_DEPTH >= 3, "the biquad reads two previous frames from the history");
+
+    int filter(const typename gesture_temporal_filter<N>::History &history, int16_t *out) override
+    {
+        return this->biquad(history, B0, B1, B2, A1, A2, out);
+    }
+
+    void reset(const int16_t *frame) override { this->start(frame, B0 + B1 + B2, A1 + A2); }
+
+};
+
+template <uint16_t N>
+class gesture_biquad_filter_runtime : public gesture_temporal_filter<N>, private gesture_biquad_state<N>
+{
+
+public:
+    // a0 is taken as 1
+    void set_coefficients(const float b0, const float b1, const float b2, const float a1, const float a2)
+    {
+        _b0 = GESTURE_FLOAT_TO_Q14(b0);
+        _b1 = GESTURE_FLOAT_TO_Q14(b1);
+        _b2 = GESTURE_FLOAT_TO_Q14(b2);
+        _a1 = GESTURE_FLOAT_TO_Q14(a1);
+        _a2 = GESTURE_FLOAT_TO_Q14(a2);
+    }
+
+    int filter(const typename gesture_temporal_filter<N>::History &history, int16_t *out) override
+    {
+        return this->biquad(history, _b0, _b1, _b2, _a1, _a2, out);
+    }
+
+    void reset(const int16_t *frame) override { this->start(frame, _b0 + _b1 + _b2, _a1 + _a2); }
+
+private:
+    int32_t _b0 = GESTURE_Q14_ONE, _b1 = 0, _b2 = 0, _a1 = 0, _a2 = 0;
+
+};
+
+
+/*
+* First order EMA: s += alpha * (x - s). gesture_ema_filter takes alpha = 2^-Shift and needs no
+* multiply; gesture_ema_filter_runtime takes any alpha, in Q15.
+*/
+template <uint16_t N>
+class gesture_ema_state
+{
+
+protected:
+    template <class Step>
+    int ema(const int16_t *x, int16_t *out, Step step)
+    {
+        int max_pixel = -99999;
+        for (uint16_t i = 0; i < N; i++) {
+            _s[i] += step(x[i] * (1 << GESTURE_FILTER_STATE_BITS) - _s[i]);
+            out[i] = gesture_filter_saturate((_s[i] + (1 << (GESTURE_FILTER_STATE_BITS - 1))) >> GESTURE_FILTER_STATE_BITS);
+            if (out[i] > max_pixel) max_pixel = out[i];
+        }
+        return max_pixel;
+    }
+
+    void start(const int16_t *frame)
+    {
+        for (uint16_t i = 0; i < N; i++) _s[i] = frame[i] * (1 << GESTURE_FILTER_STATE_BITS);
+    }
+
+    int32_t _s[N] = {};
+
+};
+
+template <uint16_t N, uint8_t Shift>
+class gesture_ema_filter : public gesture_temporal_filter<N>, private gesture_ema_state<N>
+{
+
+public:
+    static_assert(Shift <= 15, "EMA alpha below 2^-15");
+
+    int filter(const typename gesture_temporal_filter<N>::History &history, int16_t *out) override
+    {
+        return this->ema(history.newest(0), out, [](const int32_t d) { return d >> Shift; });
+    }
+
+    void reset(const int16_t *frame) override { this->start(frame); }
+
+};
+
+template <uint16_t N>
+class gesture_ema_filter_runtime : public gesture_temporal_filter<N>, private gesture_ema_state<N>
+{
+
+public:
+    void set_alpha(const float alpha) { _alpha = GESTURE_FLOAT_TO_Q15_SIGNED(alpha); }
+
+    int filter(const typename gesture_temporal_filter<N>::History &history, int16_t *out) override
+    {
+        const int32_t alpha = _alpha;
+        return this->ema(history.newest(0), out, [alpha](const int32_t d) { return (int32_t)(((int64_t)d * alpha) >> 15); });
+    }
+
+    void reset(const int16_t *frame) override { this->start(frame); }
+
+private:
+    int32_t _alpha = GESTURE_Q15_ONE;
+
+};
+
+
+#endif // __GESTURE_FILTER_BANK_H__
@@ -0,0 +1,99 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* gesture_frame_history: the last Depth frames of FrameSize pixels in a ring
+*
+* push() copies a frame into the oldest slot and makes it the newest, so a frame is written once and
+* never moved again; the frames are reached through newest(k) (k frames back) and oldest(k). Used by
+* basic_gesture_lib as the window filter history (frameHistory()), which downstream code can read too.
+*/
+
+#ifndef __GESTURE_FRAME_HISTORY_H__
+#define __GESTURE_FRAME_HISTORY_H__
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+template <uint16_t FrameSize, uint16_t Depth>
+class gesture_frame_history
+{
+
+public:
+    static_assert(Depth >= 1, "frame history must hold at least one frame");
+
+    static constexpr uint16_t frame_size = FrameSize;
+    static constexpr uint16_t depth = Depth;
+
+    // Stores frame as the newest, replacing the oldest once the history is full
+    void push(const int16_t *frame)
+    {
+        _newest = _newest + 1 < Depth ? _newest + 1 : 0;
+        memcpy(slot(_newest), frame, FrameSize * sizeof(int16_t));
+        if (_count < Depth) _count++;
+    }
+
+    // Every entry becomes a copy of frame, e.g. to start a filter without a transient
+    void fill(const int16_t *frame)
+    {
+        for (uint16_t k = 0; k < Depth; k++) memcpy(slot(k), frame, FrameSize * sizeof(int16_t));
+        _newest = Depth - 1;
+        _count = Depth;
+    }
+
+    void clear(void) { _count = 0; }
+
+    // Number of frames held, up to Depth
+    uint16_t count(void) const { return _count; }
+
+    // Frame pushed k pushes before the newest one (newest(0) is the newest), k < count()
+    const int16_t *newest(const uint16_t k = 0) const { return slot(_newest >= k ? _newest - k : _newest + Depth - k); }
+
+    // The k-th frame counted from the oldest held one (oldest(0) is the oldest), k < count()
+    const int16_t *oldest(const uint16_t k = 0) const { return newest(_count - 1 - k); }
+
+private:
+    int16_t *slot(const uint16_t index) { return &_frames[index * FrameSize]; }
+    const int16_t *slot(const uint16_t index) const { return &_frames[index * FrameSize]; }
+
+    std::array<int16_t, FrameSize * Depth> _frames;
+    uint16_t _newest = Depth - 1;
+    uint16_t _count = 0;
+
+};
+
+
+#endif // __GESTURE_FRAME_HISTORY_H__
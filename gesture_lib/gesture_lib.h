@@ -41,13 +41,22 @@
 #define __GESTURE_LIB_H__
 
 #include "mbed.h"
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include "gesture_lib_simd.h"
+#include "gesture_frame_history.h"
+#include "stage_profiler.h"
 
 #define DY_PIXEL_SCALE              (1.66667) /*10.0f/6.0f*/
 
-// Interpolation used in gesture algorithm
+// Interpolation used in gesture algorithm (default InterpFactor of basic_gesture_lib)
 #define INTERP_FACTOR               4
 
+// Pixel array dimensions of the gesture_lib wrapper class (MAX25x05 SENSOR_COLS x SENSOR_ROWS)
+#define GESTURE_LIB_DEFAULT_COLS    (10u)
+#define GESTURE_LIB_DEFAULT_ROWS    (6u)
+
 #define BACKGROUND_FILTER_ALPHA     (0.10F) /*Changed from 0.10f for 400um device*/
 #define LOW_PASS_FILTER_ALPHA       (1.0F)
 #define ZERO_CLAMP_THRESHOLD_FACTOR (6u)
@@ -56,86 +65,265 @@
 #define END_DETECTION_THRESHOLD     (250u) /*Changed from 250 for 400um device*/
 #define WINDOW_FILTER_ALPHA         (0.5F)
 
-const uint8_t PIXELSECTOR[60] = {1,1,1,1,1,2,2,2,2,2,1,1,1,1,0,0,2,2,2,2,1,1,1,0,0,0,0,2,2,2,4,4,4,0,0,0,0,3,3,3,4,4,4,4,0,0,3,3,3,3,4,4,4,4,4,3,3,3,3,3};
+// Raw frames kept by each gesture_lib (frameHistory()), at least the 3 of the window filter
+// (mbed_app.json "frame-history-depth")
+#ifndef GESTURE_HISTORY_DEPTH
+#define GESTURE_HISTORY_DEPTH       3
+#endif
 
+// Gesture classification, distances in dynamicResult cmx/cmy units (sensor pixels, y scaled by DY_PIXEL_SCALE)
+#define SWIPE_MIN_TRAVEL            (3.0F)  // Net movement along the swipe axis for L/R/U/D
+#define SWIPE_FULL_TRAVEL           (6.0F)  // Movement that counts as full confidence
+#define SWIPE_MIN_STRAIGHTNESS      (0.6F)  // |main axis| / (|main axis| + |cross axis|)
+#define CLICK_MAX_TRAVEL            (1.0F)  // Largest extent of the centroid path for a click
+#define CLICK_MIN_FRAMES            (3u)
+#define CLICK_MAX_FRAMES            (30u)
 
-  
-class gesture_lib
-{
+// GEST_TRACKING alpha-beta filter on the centroid. BETA = ALPHA^2/(2-ALPHA) is critically damped.
+#define TRACKING_FILTER_ALPHA       (0.6F)
+#define TRACKING_FILTER_BETA        (0.25F)
+#define TRACKING_PREDICTION_FRAMES  (1.0F)  // Default prediction horizon; 1 frame makes up for the window filter delay
 
-public:
+// Set GESTURE_LIB_FIXED_POINT to 1 (mbed_app.json "gesture-fixed-point") to run the filters and the
+// interpolation in Q15/int32 fixed point instead of float. Compared with the float build:
+//  - noiseWindow3Filter and interpn are bit-exact (WINDOW_FILTER_ALPHA 0.5 and INTERP_FACTOR 4 are
+//    exact in Q15), so any difference comes from subtractBackground
+//  - the background EMA keeps Q15 state and rounds its input step to the nearest pixel count, so
+//    a background subtracted pixel may differ by +/-1 from the float build
+//  - measured on the host (host/bench, 20000 synthetic frames) cmx/cmy differ by less than 0.02
+//    pixel and CoM_Intensity by less than 1%; a frame whose maxpixel is within 1 count of
+//    END_DETECTION_THRESHOLD may report a different state
+// Float is the default. The MAX32620 has an FPU, and on the host (gesture_bench vs gesture_bench_fx)
+// the fixed point window and background filters take about twice as long as the float ones. No target
+// measurement shows fixed point to be faster; it is meant for parts without an FPU.
+#ifndef GESTURE_LIB_FIXED_POINT
+#define GESTURE_LIB_FIXED_POINT     0
+#endif
 
-    gesture_lib(const uint8_t PixelArrayCols, const uint8_t PixelArrayRows):
-        _PixelArrayCols(PixelArrayCols), _PixelArrayRows(PixelArrayRows), _PixelArraySize(PixelArrayCols*PixelArrayRows),
-        _NUM_INTERP_COLS((_PixelArrayCols-1)*INTERP_FACTOR+1), _NUM_INTERP_ROWS((_PixelArrayRows-1)*INTERP_FACTOR+1),
-        _NUM_INTERP_PIXELS(_NUM_INTERP_COLS*_NUM_INTERP_ROWS)
-    {
-        pixels = new int16_t[_PixelArraySize];
-        _nwin[0] = new int16_t[_PixelArraySize];
-        _nwin[1] = new int16_t[_PixelArraySize];
-        _nwin[2] = new int16_t[_PixelArraySize];
-        _interp_pixels = new int16_t[_NUM_INTERP_PIXELS];
-        _foreground_pixels = new float[_PixelArraySize];
-        _background_pixels = new float[_PixelArraySize];
+#define GESTURE_Q15_ONE             (32768)
+#define GESTURE_FLOAT_TO_Q15(x)     ((int32_t)((x) * 32768.0F + 0.5F))
 
-    };
-    
-    ~gesture_lib()
-    {
-        delete []pixels;
-        delete []_nwin[0];
-        delete []_nwin[1];
-        delete []_nwin[2];
-        delete []_interp_pixels;
-        delete []_foreground_pixels;
-        delete []_background_pixels;
-    };
+#if GESTURE_LIB_FIXED_POINT
+typedef int32_t gesture_state_t;     // Pixel value in Q15 (pixel * 32768)
+#define GESTURE_PIXEL_TO_STATE(p)   ((int32_t)(p) * GESTURE_Q15_ONE)
+#else
+typedef float gesture_state_t;
+#define GESTURE_PIXEL_TO_STATE(p)   ((float)(p))
+#endif
+
+// Temporal filters that can take the place of the window filter (setTemporalFilter)
+#include "gesture_filter_bank.h"
 
+// Sectors of the 10x6 pixel array: 0 centre, 1 top left, 2 top right, 3 bottom right, 4 bottom left.
+// Other array sizes use the sector of the matching position in this map (gesture_calc_sector_map).
+#define GESTURE_SECTOR_MAP_COLS     (10u)
+#define GESTURE_SECTOR_MAP_ROWS     (6u)
+#define GESTURE_NUM_SECTORS         (5u)
+constexpr uint8_t PIXELSECTOR[60] = {1,1,1,1,1,2,2,2,2,2,1,1,1,1,0,0,2,2,2,2,1,1,1,0,0,0,0,2,2,2,4,4,4,0,0,0,0,3,3,3,4,4,4,4,0,0,3,3,3,3,4,4,4,4,4,3,3,3,3,3};
+
+
+// Gesture enumerations and result structures shared by every basic_gesture_lib size
+class gesture_lib_types
+{
+
+public:
     /* Enumerate for gesture type analysis */
+    // GEST_DYNAMIC_FAST gives the same result fields as GEST_DYNAMIC but estimates the center of mass
+    // straight from the sensor pixels (see calcCenterOfMassFast) without interpolating
     typedef enum {
         GEST_DYNAMIC,
-        GEST_TRACKING
+        GEST_TRACKING,
+        GEST_DYNAMIC_FAST
     } GestureType;
 
     // Gesture states
     typedef enum {STATE_INACTIVE, GESTURE_IN_PROGRESS} GestureState;
 
+    // Gesture events, reported in the frame in which the gesture ends.
+    // LEFT/RIGHT/UP/DOWN follow the cmx/cmy axes (LEFT: cmx decreasing, UP: cmy decreasing).
+    typedef enum {GEST_NONE, GEST_LEFT, GEST_RIGHT, GEST_UP, GEST_DOWN, GEST_CLICK} GestureEvent;
+
     // Structure to store dynamic gesture results
     typedef struct {
         uint8_t state;              // 0: inactive; 1: object detected; 2: rotation in progress
-        uint32_t n_sample;          // The current sample number of this gesture
+        uint32_t n_sample;          // The current sample number of this gesture, 0 while inactive
         int maxpixel;               // Maximum pixel value for this frame
         float cmx;                  // Object x-position
         float cmy;                  // Object y-position
         uint32_t CoM_Intensity;     // Object CoM intensity value
+        uint8_t event;              // GestureEvent, GEST_NONE except in the frame a gesture ended
+        float event_confidence;     // 0.0 - 1.0
+        uint32_t event_frames;      // Duration of the gesture that produced the event, in frames
+        uint32_t event_start_frame; // Frame count (since the last reset) at which that gesture started
+        // Filled with the centroid, so only in frames with maxpixel >= END_DETECTION_THRESHOLD (0 otherwise)
+        uint8_t peak_sector;        // PIXELSECTOR sector of the maximum pixel
+        uint32_t sector_energy[GESTURE_NUM_SECTORS];   // Sum of the pixels at or above the zero clamp threshold, per sector
     } DynamicGestureResult;
 
+    // Structure to store tracking results (GEST_TRACKING), in dynamicResult cmx/cmy units
+    typedef struct {
+        uint8_t state;              // 0: inactive; 1: object tracked
+        float x;                    // Filtered position
+        float y;
+        float vx;                   // Velocity, per frame
+        float vy;
+        float px;                   // Position predicted predictionFrames ahead, for cursor control
+        float py;
+    } TrackingResult;
+
+};
+
+
+// Per column (or row) weights used by GEST_DYNAMIC_FAST: the sum of the bilinear (tent) weights,
+// scaled by the interpolation factor, with which each sensor pixel contributes to the interpolated
+// grid, and the same weights multiplied by the grid index
+template <uint16_t N>
+struct gesture_fast_weights {
+    int32_t weight[N];
+    int32_t moment[N];
+};
+
+// PIXELSECTOR scaled to a Cols x Rows pixel array
+template <uint16_t Cols, uint16_t Rows>
+struct gesture_sector_map {
+    uint8_t sector[Cols * Rows];
+};
+
+template <uint16_t Cols, uint16_t Rows>
+constexpr gesture_sector_map<Cols, Rows> gesture_calc_sector_map()
+{
+    gesture_sector_map<Cols, Rows> m = {};
+    for (int y = 0; y < Rows; y++) {
+        for (int x = 0; x < Cols; x++) {
+            m.sector[y * Cols + x] = PIXELSECTOR[(y * GESTURE_SECTOR_MAP_ROWS / Rows) * GESTURE_SECTOR_MAP_COLS + x * GESTURE_SECTOR_MAP_COLS / Cols];
+        }
+    }
+    return m;
+}
+
+template <uint16_t N, uint16_t InterpFactor>
+constexpr gesture_fast_weights<N> gesture_calc_fast_weights()
+{
+    gesture_fast_weights<N> w = {};
+    for (int p = 0; p < N; p++) {
+        for (int j = p * InterpFactor - (InterpFactor - 1); j <= p * InterpFactor + (InterpFactor - 1); j++) {
+            if (j < 0 || j > (N - 1) * InterpFactor) continue;
+            int d = j - p * InterpFactor;
+            int tent = InterpFactor - (d < 0 ? -d : d);
+            w.weight[p] += tent;
+            w.moment[p] += j * tent;
+        }
+    }
+    return w;
+}
+
+
+/*
+* Gesture processing for a Cols x Rows pixel array interpolated by InterpFactor.
+* All dimensions are compile time constants and every buffer is a member std::array, so there is no
+* heap use and the RAM needed per instance is sizeof(basic_gesture_lib<...>), visible at link time.
+*/
+template <uint16_t Cols, uint16_t Rows, uint16_t InterpFactor = INTERP_FACTOR>
+class basic_gesture_lib : public gesture_lib_types
+{
+
+public:
+    static_assert(Cols >= 2 && Rows >= 2, "pixel array must be at least 2x2");
+    static_assert(InterpFactor >= 1, "interpolation factor must be at least 1");
+    static_assert((uint32_t)((Cols-1)*InterpFactor+1) * ((Rows-1)*InterpFactor+1) <= UINT16_MAX,
+                  "interpolated frame is too large");
+
+    static constexpr uint16_t PixelArrayCols = Cols;
+    static constexpr uint16_t PixelArrayRows = Rows;
+    static constexpr uint16_t PixelArraySize = Cols * Rows;
+    static constexpr uint16_t NumInterpCols = (Cols - 1) * InterpFactor + 1;
+    static constexpr uint16_t NumInterpRows = (Rows - 1) * InterpFactor + 1;
+    static constexpr uint16_t NumInterpPixels = NumInterpCols * NumInterpRows;
+
+    static_assert(GESTURE_HISTORY_DEPTH >= 3, "the window filter needs a frame history of at least 3 frames");
+    typedef gesture_frame_history<PixelArraySize, GESTURE_HISTORY_DEPTH> FrameHistory;
+
+private:
+    // Declared ahead of the public pixels pointer that is initialised from it
+    int16_t _pixels[PixelArraySize];
+
+public:
+    basic_gesture_lib(): pixels(_pixels) {};
+
+    // pixels points into this object's own storage
+    basic_gesture_lib(const basic_gesture_lib &) = delete;
+    basic_gesture_lib &operator=(const basic_gesture_lib &) = delete;
+
     DynamicGestureResult dynamicResult;
 
-    int16_t *pixels;
+    int16_t *const pixels;
     int MaxPixelValue = -99999;
 
+    // By default the interpolation, thresholding and center of mass run as one fused pass that never
+    // stores the interpolated frame. Set to true to run the original separate stages instead and keep
+    // the thresholded interpolated frame available from interpPixels() for debug or visualization.
+    bool keepInterpFrame = false;
+
+    // The fused pass only interpolates the sensor pixels around the ones at or above the zero clamp
+    // threshold (findRegionOfInterest). No interpolated pixel outside that window can reach the
+    // threshold, so the result is the same as over the whole frame. Set to false to always process
+    // the whole frame.
+    bool regionOfInterest = true;
+
+    const int16_t *interpPixels(void) const { return _interp_pixels.data(); }
+
+    // Raw frames as they came in, newest(0) being the one processed last. Only kept while the window
+    // filter runs; after a reset every entry holds the first frame.
+    const FrameHistory &frameHistory(void) const { return _history; }
+
+    // Runs filter (gesture_filter_bank.h) on each frame in place of the window filter, e.g. an FIR over
+    // more history frames or a biquad for stronger noise rejection. It still only runs when
+    // processGesture() gets a window_filter_alpha > 0, and is restarted on resetGesture(). NULL goes
+    // back to the window filter. The filter is not copied and has to outlive its use.
+    void setTemporalFilter(gesture_temporal_filter<PixelArraySize> *filter) { _temporal_filter = filter; }
+
+    // GEST_TRACKING runs the dynamic gesture processing (dynamicResult is filled as well) and then an
+    // alpha-beta filter on the centroid
+    TrackingResult trackingResult;
+    float trackingAlpha = TRACKING_FILTER_ALPHA;
+    float trackingBeta = TRACKING_FILTER_BETA;
+    float predictionFrames = TRACKING_PREDICTION_FRAMES;
+
 
     void processGesture(const float window_filter_alpha, GestureType Gtype);
     void resetGesture(void);
 
+    // Processes n frames of PixelArraySize pixels stored back to back, for offline analysis of recordings.
+    // out[t] receives dynamicResult of frame t; the results and the filter state afterwards are the same
+    // as calling processGesture() on each frame in turn. pixels is overwritten.
+    void processGestureBatch(const int16_t *frames, const size_t n, DynamicGestureResult *out,
+                             const float window_filter_alpha = WINDOW_FILTER_ALPHA, GestureType Gtype = GEST_DYNAMIC);
+
 private:
+    // The host benchmark (host/bench) times each processing stage on its own
+    friend class gesture_lib_bench;
+
     void noiseWindow3Filter(const float alpha);
-    void runDynamicGesture(void);
+    int windowFilter(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const float alpha);
+    void runDynamicGesture(const bool fast_centroid);
     void subtractBackground(const float alpha_short_avg, const float alpha_long_avg);
     void interpn();
     unsigned int zeroPixelsBelowThreshold(const int threshold);
     void calcCenterOfMass(float *cmx, float *cmy, int32_t *totalmass);
+    void findRegionOfInterest(const int threshold);
+    void interpThresholdCenterOfMass(const int threshold1, const int threshold2, float *cmx, float *cmy, int32_t *totalmass);
+    void interpRow(const int16_t *src, int16_t *dst, const int x0, const int x1);
+    void calcCenterOfMassFast(const int threshold1, const int threshold2, float *cmx, float *cmy, int32_t *totalmass);
+    void trackTrajectory(const float cmx, const float cmy);
+    void runTracking(void);
+    GestureEvent classifyTrajectory(float *confidence) const;
 
-    const uint8_t _PixelArrayCols;
-    const uint8_t _PixelArrayRows;
-    const uint8_t _PixelArraySize;
-    const uint8_t _NUM_INTERP_COLS;
-    const uint8_t _NUM_INTERP_ROWS;
-    const uint16_t _NUM_INTERP_PIXELS;
+    static constexpr gesture_fast_weights<Cols> _fast_x = gesture_calc_fast_weights<Cols, InterpFactor>();
+    static constexpr gesture_fast_weights<Rows> _fast_y = gesture_calc_fast_weights<Rows, InterpFactor>();
+    static constexpr gesture_sector_map<Cols, Rows> _sectors = gesture_calc_sector_map<Cols, Rows>();
 
-    // Enumerate gesture events here
-    typedef enum {GEST_NONE, GEST_PLACEHOLDER} GestureEvent;
+    // Sensor pixel window of the fused pass, inclusive (findRegionOfInterest). Empty if _roi_x0 > _roi_x1.
+    int _roi_x0 = 0, _roi_x1 = Cols - 1, _roi_y0 = 0, _roi_y1 = Rows - 1;
 
     GestureState _state =   STATE_INACTIVE;
 
@@ -143,12 +331,49 @@ private:
     uint32_t _n_sample =    0;
     uint32_t _n_frame =     0;
 
-    int16_t *_nwin[3];
-    int16_t *_interp_pixels;
-    float *_foreground_pixels;
-    float *_background_pixels;
+    // Centroid path of the gesture in progress, summarised as it goes (classifyTrajectory)
+    struct {
+        float start_x, start_y;
+        float last_x, last_y;
+        float min_x, max_x, min_y, max_y;
+        uint32_t start_frame;
+    } _path = {};
+
+    // Alpha-beta filter state of GEST_TRACKING
+    bool _tracking = false;
+    float _track_x = 0, _track_y = 0, _track_vx = 0, _track_vy = 0;
+
+    FrameHistory _history;
+    gesture_temporal_filter<PixelArraySize> *_temporal_filter = NULL;
+    std::array<int16_t, NumInterpPixels> _interp_pixels;
+    std::array<int16_t, NumInterpCols> _interp_line[2];
+    std::array<gesture_state_t, PixelArraySize> _foreground_pixels;
+    std::array<gesture_state_t, PixelArraySize> _background_pixels;
 
 };
 
 
+/*
+* The original run time sized interface, kept for existing code: gesture_lib(SENSOR_COLS, SENSOR_ROWS).
+* The arguments must match GESTURE_LIB_DEFAULT_COLS x GESTURE_LIB_DEFAULT_ROWS; use basic_gesture_lib
+* directly for any other pixel array or interpolation factor.
+*/
+class gesture_lib : public basic_gesture_lib<GESTURE_LIB_DEFAULT_COLS, GESTURE_LIB_DEFAULT_ROWS, INTERP_FACTOR>
+{
+
+public:
+    gesture_lib(const uint8_t PixelArrayCols, const uint8_t PixelArrayRows)
+    {
+        MBED_ASSERT(PixelArrayCols == GESTURE_LIB_DEFAULT_COLS && PixelArrayRows == GESTURE_LIB_DEFAULT_ROWS);
+    };
+
+};
+
+
+#include "gesture_lib_impl.h"
+
+// The default size is instantiated once in gesture_lib.cpp
+extern template class basic_gesture_lib<GESTURE_LIB_DEFAULT_COLS, GESTURE_LIB_DEFAULT_ROWS, INTERP_FACTOR>;
+
+
 #endif  // __GESTURE_LIB_H__
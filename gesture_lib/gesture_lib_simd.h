@@ -0,0 +1,633 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Per pixel kernels of gesture_lib: the 3 frame window filter and the background subtraction EMA.
+* Both run over separate state arrays (structure of arrays), so they vectorise across pixels.
+*
+* Float path: with GESTURE_LIB_SIMD the host build uses SSE2 (x86) or NEON (ARM), otherwise the scalar
+* versions below are used. An x86 build with AVX2 enabled (host CMake option GESTURE_HOST_AVX2, or
+* -mavx2 / -march=native) runs 16 pixels per iteration and hands the remainder to the SSE2 kernel.
+*
+* The vectors run across the pixels of one frame, not across frames: every filter output depends on the
+* state the previous frame left behind (window of consecutive frames, recursive EMA), so frames have to
+* be filtered in order. processGestureBatch() therefore gains from the per-frame overhead it removes,
+* not from wider vectors; a 60 pixel frame fills 3 AVX2 iterations plus one SSE2 step and a short tail.
+*
+* The vector kernels apply the same float operations in the same order as the scalar code, truncate
+* toward zero and wrap to int16 like the scalar conversions, so their results are bit-identical. That
+* holds as long as the compiler does not contract the scalar a*b+c into a fused multiply-add
+* (x86-64 has no FMA by default; the host build passes -ffp-contract=off for other targets).
+*
+* Fixed point path (GESTURE_LIB_FIXED_POINT): with GESTURE_LIB_DSP the Q15 filters use the Cortex-M4/M7
+* DSP instructions. Pixels are loaded and stored in pairs, one 32 bit word per two int16 pixels, and the
+* running maximum is kept in both halfwords with __SSUB16 and __SEL instead of a branch per pixel. In the
+* window filter one __SADD16 adds the outer taps of two pixels, and one __SMLAD per pixel multiplies
+* (n0+n2, n1) by (1-alpha, 2*alpha) after __PKHBT/__PKHTB has packed them into one word. The background
+* EMA keeps 32 bit state per pixel, which the halfword instructions cannot work on, so its filter steps
+* stay one 32 bit multiply-accumulate each; only its pixel loads, stores and maximum are paired. Off
+* target the kernels run on portable C versions of the instructions, which the host benchmark
+* (gesture_bench --verify) compares with the scalar loops.
+*
+* The DSP kernels are only used by the fixed point build. The default float build runs the scalar float
+* loops on the target's FPU.
+*/
+
+#ifndef __GESTURE_LIB_SIMD_H__
+#define __GESTURE_LIB_SIMD_H__
+
+#include <cstdint>
+#include <cstring>
+
+#ifndef GESTURE_LIB_SIMD
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#define GESTURE_LIB_SIMD            1
+#else
+#define GESTURE_LIB_SIMD            0
+#endif
+#endif
+
+#if GESTURE_LIB_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#else
+#error "GESTURE_LIB_SIMD needs SSE2 or NEON"
+#endif
+#endif
+
+
+// out = alpha*n1 + (1-alpha)*(n0+n2)/2 for n pixels. Returns the largest output pixel (-99999 if n is 0).
+inline int gesture_window3_scalar(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n,
+                                  const float alpha, const unsigned int start = 0)
+{
+    int max_pixel = -99999;
+    for (unsigned int i = start; i < n; i++) {
+        out[i] = alpha * n1[i] + (1-alpha)*(n0[i] + n2[i])/2;
+        if (out[i] > max_pixel) max_pixel = out[i];
+    }
+    return max_pixel;
+}
+
+// Exponential averages of the input with a short and a long time constant, out = short - long.
+// Returns the largest output pixel (-99999 if n is 0).
+inline int gesture_subtract_background_scalar(const int16_t *in, float *fg, float *bg, int16_t *out, const unsigned int n,
+                                              const float alpha_short_avg, const float alpha_long_avg, const unsigned int start = 0)
+{
+    int max_pixel = -99999;
+    for (unsigned int i = start; i < n; i++) {
+        bg[i] = (1.0f - alpha_long_avg) * bg[i] + alpha_long_avg * (float)in[i];
+        fg[i] = (1.0f - alpha_short_avg) * fg[i] + alpha_short_avg * (float)in[i];
+        out[i] = (int16_t)(fg[i] - bg[i]);
+        if (out[i] > max_pixel) max_pixel = out[i];
+    }
+    return max_pixel;
+}
+
+
+#if GESTURE_LIB_SIMD
+
+#if defined(__SSE2__)
+
+// 8 int16 -> two float vectors
+static inline void gesture_simd_load8(const int16_t *p, __m128 &lo, __m128 &hi)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i *)p);
+    lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+    hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+}
+
+static inline __m128i gesture_simd_load8_i32(const int16_t *p, __m128i &hi)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i *)p);
+    hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+// Truncates two float vectors to int16 (wrapping like the scalar conversion) and stores them
+static inline __m128i gesture_simd_store8(int16_t *p, const __m128 lo, const __m128 hi)
+{
+    const __m128i ilo = _mm_srai_epi32(_mm_slli_epi32(_mm_cvttps_epi32(lo), 16), 16);
+    const __m128i ihi = _mm_srai_epi32(_mm_slli_epi32(_mm_cvttps_epi32(hi), 16), 16);
+    const __m128i v = _mm_packs_epi32(ilo, ihi);
+    _mm_storeu_si128((__m128i *)p, v);
+    return v;
+}
+
+static inline int gesture_simd_hmax16(__m128i v)
+{
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_epi16(v, _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (int16_t)_mm_cvtsi128_si32(v);
+}
+
+inline int gesture_window3_sse2(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n,
+                                const float alpha, const unsigned int start = 0)
+{
+    const __m128 a = _mm_set1_ps(alpha);
+    const __m128 c = _mm_set1_ps(1-alpha);
+    const __m128 two = _mm_set1_ps(2.0f);
+    __m128i vmax = _mm_set1_epi16(INT16_MIN);
+    unsigned int i = start;
+    for (; i + 8 <= n; i += 8) {
+        __m128 f1_lo, f1_hi;
+        gesture_simd_load8(n1 + i, f1_lo, f1_hi);
+        __m128i s0_hi, s2_hi;
+        const __m128i s0_lo = gesture_simd_load8_i32(n0 + i, s0_hi);
+        const __m128i s2_lo = gesture_simd_load8_i32(n2 + i, s2_hi);
+        const __m128 sum_lo = _mm_cvtepi32_ps(_mm_add_epi32(s0_lo, s2_lo));
+        const __m128 sum_hi = _mm_cvtepi32_ps(_mm_add_epi32(s0_hi, s2_hi));
+        const __m128 lo = _mm_add_ps(_mm_mul_ps(a, f1_lo), _mm_div_ps(_mm_mul_ps(c, sum_lo), two));
+        const __m128 hi = _mm_add_ps(_mm_mul_ps(a, f1_hi), _mm_div_ps(_mm_mul_ps(c, sum_hi), two));
+        vmax = _mm_max_epi16(vmax, gesture_simd_store8(out + i, lo, hi));
+    }
+    int max_pixel = (i > start) ? gesture_simd_hmax16(vmax) : -99999;
+    const int tail_max = gesture_window3_scalar(n0, n1, n2, out, n, alpha, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+inline int gesture_subtract_background_sse2(const int16_t *in, float *fg, float *bg, int16_t *out, const unsigned int n,
+                                            const float alpha_short_avg, const float alpha_long_avg, const unsigned int start = 0)
+{
+    const __m128 as = _mm_set1_ps(alpha_short_avg);
+    const __m128 cs = _mm_set1_ps(1.0f - alpha_short_avg);
+    const __m128 al = _mm_set1_ps(alpha_long_avg);
+    const __m128 cl = _mm_set1_ps(1.0f - alpha_long_avg);
+    __m128i vmax = _mm_set1_epi16(INT16_MIN);
+    unsigned int i = start;
+    for (; i + 8 <= n; i += 8) {
+        __m128 p_lo, p_hi;
+        gesture_simd_load8(in + i, p_lo, p_hi);
+        const __m128 bg_lo = _mm_add_ps(_mm_mul_ps(cl, _mm_loadu_ps(bg + i)), _mm_mul_ps(al, p_lo));
+        const __m128 bg_hi = _mm_add_ps(_mm_mul_ps(cl, _mm_loadu_ps(bg + i + 4)), _mm_mul_ps(al, p_hi));
+        const __m128 fg_lo = _mm_add_ps(_mm_mul_ps(cs, _mm_loadu_ps(fg + i)), _mm_mul_ps(as, p_lo));
+        const __m128 fg_hi = _mm_add_ps(_mm_mul_ps(cs, _mm_loadu_ps(fg + i + 4)), _mm_mul_ps(as, p_hi));
+        _mm_storeu_ps(bg + i, bg_lo);
+        _mm_storeu_ps(bg + i + 4, bg_hi);
+        _mm_storeu_ps(fg + i, fg_lo);
+        _mm_storeu_ps(fg + i + 4, fg_hi);
+        vmax = _mm_max_epi16(vmax, gesture_simd_store8(out + i, _mm_sub_ps(fg_lo, bg_lo), _mm_sub_ps(fg_hi, bg_hi)));
+    }
+    int max_pixel = (i > start) ? gesture_simd_hmax16(vmax) : -99999;
+    const int tail_max = gesture_subtract_background_scalar(in, fg, bg, out, n, alpha_short_avg, alpha_long_avg, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+#if defined(__AVX2__)
+
+// 16 int16 -> two 8 wide float vectors
+static inline void gesture_simd_load16(const int16_t *p, __m256 &lo, __m256 &hi)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+    hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+}
+
+static inline __m256i gesture_simd_load16_i32(const int16_t *p, __m256i &hi)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+    return _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+}
+
+// Truncates two float vectors to int16 (wrapping like the scalar conversion) and stores them. The
+// pack works per 128 bit lane, the permute puts the four 64 bit quarters back in pixel order.
+static inline __m256i gesture_simd_store16(int16_t *p, const __m256 lo, const __m256 hi)
+{
+    const __m256i ilo = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_cvttps_epi32(lo), 16), 16);
+    const __m256i ihi = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_cvttps_epi32(hi), 16), 16);
+    const __m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(ilo, ihi), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i *)p, v);
+    return v;
+}
+
+static inline int gesture_simd_hmax16x2(const __m256i v)
+{
+    return gesture_simd_hmax16(_mm_max_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+// 16 pixels per iteration, the SSE2 kernel takes the next 8 and the scalar loop the rest
+inline int gesture_window3(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n, const float alpha)
+{
+    const __m256 a = _mm256_set1_ps(alpha);
+    const __m256 c = _mm256_set1_ps(1-alpha);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    __m256i vmax = _mm256_set1_epi16(INT16_MIN);
+    unsigned int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 f1_lo, f1_hi;
+        gesture_simd_load16(n1 + i, f1_lo, f1_hi);
+        __m256i s0_hi, s2_hi;
+        const __m256i s0_lo = gesture_simd_load16_i32(n0 + i, s0_hi);
+        const __m256i s2_lo = gesture_simd_load16_i32(n2 + i, s2_hi);
+        const __m256 sum_lo = _mm256_cvtepi32_ps(_mm256_add_epi32(s0_lo, s2_lo));
+        const __m256 sum_hi = _mm256_cvtepi32_ps(_mm256_add_epi32(s0_hi, s2_hi));
+        const __m256 lo = _mm256_add_ps(_mm256_mul_ps(a, f1_lo), _mm256_div_ps(_mm256_mul_ps(c, sum_lo), two));
+        const __m256 hi = _mm256_add_ps(_mm256_mul_ps(a, f1_hi), _mm256_div_ps(_mm256_mul_ps(c, sum_hi), two));
+        vmax = _mm256_max_epi16(vmax, gesture_simd_store16(out + i, lo, hi));
+    }
+    int max_pixel = (i > 0) ? gesture_simd_hmax16x2(vmax) : -99999;
+    const int tail_max = gesture_window3_sse2(n0, n1, n2, out, n, alpha, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+inline int gesture_subtract_background(const int16_t *in, float *fg, float *bg, int16_t *out, const unsigned int n,
+                                       const float alpha_short_avg, const float alpha_long_avg)
+{
+    const __m256 as = _mm256_set1_ps(alpha_short_avg);
+    const __m256 cs = _mm256_set1_ps(1.0f - alpha_short_avg);
+    const __m256 al = _mm256_set1_ps(alpha_long_avg);
+    const __m256 cl = _mm256_set1_ps(1.0f - alpha_long_avg);
+    __m256i vmax = _mm256_set1_epi16(INT16_MIN);
+    unsigned int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 p_lo, p_hi;
+        gesture_simd_load16(in + i, p_lo, p_hi);
+        const __m256 bg_lo = _mm256_add_ps(_mm256_mul_ps(cl, _mm256_loadu_ps(bg + i)), _mm256_mul_ps(al, p_lo));
+        const __m256 bg_hi = _mm256_add_ps(_mm256_mul_ps(cl, _mm256_loadu_ps(bg + i + 8)), _mm256_mul_ps(al, p_hi));
+        const __m256 fg_lo = _mm256_add_ps(_mm256_mul_ps(cs, _mm256_loadu_ps(fg + i)), _mm256_mul_ps(as, p_lo));
+        const __m256 fg_hi = _mm256_add_ps(_mm256_mul_ps(cs, _mm256_loadu_ps(fg + i + 8)), _mm256_mul_ps(as, p_hi));
+        _mm256_storeu_ps(bg + i, bg_lo);
+        _mm256_storeu_ps(bg + i + 8, bg_hi);
+        _mm256_storeu_ps(fg + i, fg_lo);
+        _mm256_storeu_ps(fg + i + 8, fg_hi);
+        vmax = _mm256_max_epi16(vmax, gesture_simd_store16(out + i, _mm256_sub_ps(fg_lo, bg_lo), _mm256_sub_ps(fg_hi, bg_hi)));
+    }
+    int max_pixel = (i > 0) ? gesture_simd_hmax16x2(vmax) : -99999;
+    const int tail_max = gesture_subtract_background_sse2(in, fg, bg, out, n, alpha_short_avg, alpha_long_avg, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+#else // SSE2 only
+
+inline int gesture_window3(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n, const float alpha)
+{
+    return gesture_window3_sse2(n0, n1, n2, out, n, alpha);
+}
+
+inline int gesture_subtract_background(const int16_t *in, float *fg, float *bg, int16_t *out, const unsigned int n,
+                                       const float alpha_short_avg, const float alpha_long_avg)
+{
+    return gesture_subtract_background_sse2(in, fg, bg, out, n, alpha_short_avg, alpha_long_avg);
+}
+
+#endif // __AVX2__
+
+#else // __ARM_NEON
+
+static inline void gesture_simd_load8(const int16_t *p, float32x4_t &lo, float32x4_t &hi)
+{
+    const int16x8_t v = vld1q_s16(p);
+    lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+    hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+}
+
+// Truncates toward zero and narrows (wrapping) to int16
+static inline int16x8_t gesture_simd_store8(int16_t *p, const float32x4_t lo, const float32x4_t hi)
+{
+    const int16x8_t v = vcombine_s16(vmovn_s32(vcvtq_s32_f32(lo)), vmovn_s32(vcvtq_s32_f32(hi)));
+    vst1q_s16(p, v);
+    return v;
+}
+
+static inline int gesture_simd_hmax16(const int16x8_t v)
+{
+    int16x4_t m = vpmax_s16(vget_low_s16(v), vget_high_s16(v));
+    m = vpmax_s16(m, m);
+    m = vpmax_s16(m, m);
+    return vget_lane_s16(m, 0);
+}
+
+inline int gesture_window3(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n, const float alpha)
+{
+    const float32x4_t a = vdupq_n_f32(alpha);
+    const float32x4_t c = vdupq_n_f32(1-alpha);
+    const float32x4_t half = vdupq_n_f32(0.5f);     // x/2 and x*0.5 are the same for these integer sums
+    int16x8_t vmax = vdupq_n_s16(INT16_MIN);
+    unsigned int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t f1_lo, f1_hi;
+        gesture_simd_load8(n1 + i, f1_lo, f1_hi);
+        const int16x8_t v0 = vld1q_s16(n0 + i);
+        const int16x8_t v2 = vld1q_s16(n2 + i);
+        const float32x4_t sum_lo = vcvtq_f32_s32(vaddl_s16(vget_low_s16(v0), vget_low_s16(v2)));
+        const float32x4_t sum_hi = vcvtq_f32_s32(vaddl_s16(vget_high_s16(v0), vget_high_s16(v2)));
+        const float32x4_t lo = vaddq_f32(vmulq_f32(a, f1_lo), vmulq_f32(vmulq_f32(c, sum_lo), half));
+        const float32x4_t hi = vaddq_f32(vmulq_f32(a, f1_hi), vmulq_f32(vmulq_f32(c, sum_hi), half));
+        vmax = vmaxq_s16(vmax, gesture_simd_store8(out + i, lo, hi));
+    }
+    int max_pixel = (i > 0) ? gesture_simd_hmax16(vmax) : -99999;
+    const int tail_max = gesture_window3_scalar(n0, n1, n2, out, n, alpha, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+inline int gesture_subtract_background(const int16_t *in, float *fg, float *bg, int16_t *out, const unsigned int n,
+                                       const float alpha_short_avg, const float alpha_long_avg)
+{
+    const float32x4_t as = vdupq_n_f32(alpha_short_avg);
+    const float32x4_t cs = vdupq_n_f32(1.0f - alpha_short_avg);
+    const float32x4_t al = vdupq_n_f32(alpha_long_avg);
+    const float32x4_t cl = vdupq_n_f32(1.0f - alpha_long_avg);
+    int16x8_t vmax = vdupq_n_s16(INT16_MIN);
+    unsigned int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t p_lo, p_hi;
+        gesture_simd_load8(in + i, p_lo, p_hi);
+        const float32x4_t bg_lo = vaddq_f32(vmulq_f32(cl, vld1q_f32(bg + i)), vmulq_f32(al, p_lo));
+        const float32x4_t bg_hi = vaddq_f32(vmulq_f32(cl, vld1q_f32(bg + i + 4)), vmulq_f32(al, p_hi));
+        const float32x4_t fg_lo = vaddq_f32(vmulq_f32(cs, vld1q_f32(fg + i)), vmulq_f32(as, p_lo));
+        const float32x4_t fg_hi = vaddq_f32(vmulq_f32(cs, vld1q_f32(fg + i + 4)), vmulq_f32(as, p_hi));
+        vst1q_f32(bg + i, bg_lo);
+        vst1q_f32(bg + i + 4, bg_hi);
+        vst1q_f32(fg + i, fg_lo);
+        vst1q_f32(fg + i + 4, fg_hi);
+        vmax = vmaxq_s16(vmax, gesture_simd_store8(out + i, vsubq_f32(fg_lo, bg_lo), vsubq_f32(fg_hi, bg_hi)));
+    }
+    int max_pixel = (i > 0) ? gesture_simd_hmax16(vmax) : -99999;
+    const int tail_max = gesture_subtract_background_scalar(in, fg, bg, out, n, alpha_short_avg, alpha_long_avg, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+#endif
+
+#else // !GESTURE_LIB_SIMD
+
+inline int gesture_window3(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n, const float alpha)
+{
+    return gesture_window3_scalar(n0, n1, n2, out, n, alpha);
+}
+
+inline int gesture_subtract_background(const int16_t *in, float *fg, float *bg, int16_t *out, const unsigned int n,
+                                       const float alpha_short_avg, const float alpha_long_avg)
+{
+    return gesture_subtract_background_scalar(in, fg, bg, out, n, alpha_short_avg, alpha_long_avg);
+}
+
+#endif
+
+
+// Nearest whole pixel value of a Q15 filter state (pixel * 32768)
+inline int32_t gesture_q15_state_to_pixel(const int32_t state)
+{
+    return (state + 32768/2) >> 15;
+}
+
+// out = alpha*n1 + (1-alpha)*(n0+n2)/2 with alpha a in Q15, evaluated over 2*Q15 so the result truncates
+// exactly like the float path. Returns the largest output pixel (-99999 if n is 0).
+inline int gesture_window3_q15_scalar(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n,
+                                      const int32_t a, const unsigned int start = 0)
+{
+    int max_pixel = -99999;
+    for (unsigned int i = start; i < n; i++) {
+        int32_t acc = 2 * a * n1[i] + (32768 - a) * (n0[i] + n2[i]);
+        out[i] = (int16_t)(acc / (2 * 32768));
+        if (out[i] > max_pixel) max_pixel = out[i];
+    }
+    return max_pixel;
+}
+
+// Exponential averages of the input in Q15 state, out = short - long. Each step is alpha(Q15) * (pixel -
+// rounded state), which stays inside int32 for any int16 input as long as alpha < 1.0. An alpha of 1.0
+// simply tracks the input. Returns the largest output pixel (-99999 if n is 0).
+inline int gesture_subtract_background_q15_scalar(const int16_t *in, int32_t *fg, int32_t *bg, int16_t *out, const unsigned int n,
+                                                  const int32_t a_short, const int32_t a_long, const unsigned int start = 0)
+{
+    int max_pixel = -99999;
+    for (unsigned int i = start; i < n; i++) {
+        bg[i] += a_long * (in[i] - gesture_q15_state_to_pixel(bg[i]));
+        if (a_short >= 32768) fg[i] = (int32_t)in[i] * 32768;
+        else fg[i] += a_short * (in[i] - gesture_q15_state_to_pixel(fg[i]));
+        out[i] = (int16_t)((fg[i] - bg[i]) / 32768);
+        if (out[i] > max_pixel) max_pixel = out[i];
+    }
+    return max_pixel;
+}
+
+
+#ifndef GESTURE_LIB_DSP
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define GESTURE_LIB_DSP             1
+#else
+#define GESTURE_LIB_DSP             0
+#endif
+#endif
+
+#if GESTURE_LIB_DSP
+#include "cmsis.h"
+
+// Halfword lanes: the low half is pixel i, the high half pixel i+1 (little endian word load)
+static inline uint32_t gesture_dsp_smlad(const uint32_t x, const uint32_t y, const int32_t acc) { return __SMLAD(x, y, (uint32_t)acc); }
+static inline uint32_t gesture_dsp_sadd16(const uint32_t x, const uint32_t y) { return __SADD16(x, y); }
+static inline uint32_t gesture_dsp_qadd16(const uint32_t x, const uint32_t y) { return __QADD16(x, y); }
+static inline uint32_t gesture_dsp_pack_low(const uint32_t x, const uint32_t y) { return __PKHBT(x, y, 16); }
+static inline uint32_t gesture_dsp_pack_high(const uint32_t x, const uint32_t y) { return __PKHTB(y, x, 16); }
+static inline uint32_t gesture_dsp_max16x2(const uint32_t x, const uint32_t y)
+{
+    (void)__SSUB16(x, y);       // sets the GE flag of each halfword where x >= y
+    return __SEL(x, y);
+}
+#else
+// Portable versions of the DSP instructions with the same results
+static inline uint32_t gesture_dsp_smlad(const uint32_t x, const uint32_t y, const int32_t acc)
+{
+    return (uint32_t)acc + (uint32_t)((int32_t)(int16_t)x * (int16_t)y) + (uint32_t)((int32_t)(int16_t)(x >> 16) * (int16_t)(y >> 16));
+}
+static inline uint32_t gesture_dsp_sadd16(const uint32_t x, const uint32_t y)
+{
+    return ((x + y) & 0xFFFFu) | (((x >> 16) + (y >> 16)) << 16);
+}
+static inline uint32_t gesture_dsp_qadd16(const uint32_t x, const uint32_t y)
+{
+    int32_t lo = (int32_t)(int16_t)x + (int16_t)y, hi = (int32_t)(int16_t)(x >> 16) + (int16_t)(y >> 16);
+    lo = (lo > INT16_MAX) ? INT16_MAX : (lo < INT16_MIN) ? INT16_MIN : lo;
+    hi = (hi > INT16_MAX) ? INT16_MAX : (hi < INT16_MIN) ? INT16_MIN : hi;
+    return ((uint32_t)lo & 0xFFFFu) | ((uint32_t)hi << 16);
+}
+static inline uint32_t gesture_dsp_pack_low(const uint32_t x, const uint32_t y) { return (x & 0xFFFFu) | (y << 16); }
+static inline uint32_t gesture_dsp_pack_high(const uint32_t x, const uint32_t y) { return (x >> 16) | (y & 0xFFFF0000u); }
+static inline uint32_t gesture_dsp_max16x2(const uint32_t x, const uint32_t y)
+{
+    const uint32_t lo = ((int16_t)x >= (int16_t)y) ? x : y;
+    const uint32_t hi = ((int16_t)(x >> 16) >= (int16_t)(y >> 16)) ? x : y;
+    return (lo & 0xFFFFu) | (hi & 0xFFFF0000u);
+}
+#endif
+
+static inline uint32_t gesture_dsp_load2(const int16_t *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static inline void gesture_dsp_store2(int16_t *p, const uint32_t v) { memcpy(p, &v, 4); }
+static inline int gesture_dsp_hmax16x2(const uint32_t v)
+{
+    const int lo = (int16_t)v, hi = (int16_t)(v >> 16);
+    return (lo > hi) ? lo : hi;
+}
+
+// acc / 2^shift rounded toward zero, like the integer division of the scalar code
+static inline int16_t gesture_dsp_div_pow2(const int32_t acc, const unsigned int shift)
+{
+    return (int16_t)((acc + (int32_t)((uint32_t)(acc >> 31) >> (32 - shift))) >> shift);
+}
+
+// Two pixels per iteration, one __SMLAD for the outer taps (n0, n2) times (1-alpha, 1-alpha) of each, plus
+// 2*alpha*n1. Used when the coefficients of gesture_window3_q15_dsp() do not fit a halfword.
+inline int gesture_window3_q15_dsp_outer(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n,
+                                         const int32_t a)
+{
+    const int32_t c = 32768 - a;
+    if (c > INT16_MAX) return gesture_window3_q15_scalar(n0, n1, n2, out, n, a);   // alpha 0 does not fit a halfword
+    const uint32_t cc = (uint32_t)(uint16_t)c * 0x00010001u;
+
+    uint32_t vmax = 0x80008000u;
+    unsigned int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const uint32_t p0 = gesture_dsp_load2(n0 + i);
+        const uint32_t p2 = gesture_dsp_load2(n2 + i);
+        const int32_t acc0 = (int32_t)gesture_dsp_smlad(gesture_dsp_pack_low(p0, p2), cc, 2 * a * n1[i]);
+        const int32_t acc1 = (int32_t)gesture_dsp_smlad(gesture_dsp_pack_high(p0, p2), cc, 2 * a * n1[i + 1]);
+        const uint32_t r = gesture_dsp_pack_low((uint32_t)(int16_t)(acc0 / (2 * 32768)), (uint32_t)(int16_t)(acc1 / (2 * 32768)));
+        gesture_dsp_store2(out + i, r);
+        vmax = gesture_dsp_max16x2(r, vmax);
+    }
+    int max_pixel = (i > 0) ? gesture_dsp_hmax16x2(vmax) : -99999;
+    const int tail_max = gesture_window3_q15_scalar(n0, n1, n2, out, n, a, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+// Two pixels per iteration. __SADD16 adds the outer taps of both pixels at once, then a single __SMLAD
+// per pixel does all three taps: (n0+n2, n1) times (1-alpha, 2*alpha). Both coefficients are divided by
+// their largest common power of two until they fit a halfword, and the result is shifted down by that
+// much less, so it stays exact. A pair whose outer tap sum overflows a halfword (pixels beyond +-16383,
+// __QADD16 saturates where __SADD16 wraps) takes the scalar loop, and alphas whose coefficients still
+// do not fit (an odd alpha in Q15 of 0.5 or more) the kernel above.
+inline int gesture_window3_q15_dsp(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n,
+                                   const int32_t a)
+{
+    int32_t c = 32768 - a, two_a = 2 * a;
+    unsigned int shift = 16;
+    while ((c > INT16_MAX || two_a > INT16_MAX) && ((c | two_a) & 1) == 0) {
+        c >>= 1;
+        two_a >>= 1;
+        shift--;
+    }
+    if (c > INT16_MAX || two_a > INT16_MAX) return gesture_window3_q15_dsp_outer(n0, n1, n2, out, n, a);
+    const uint32_t coef = gesture_dsp_pack_low((uint32_t)c, (uint32_t)two_a);
+
+    uint32_t vmax = 0x80008000u;
+    unsigned int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const uint32_t p0 = gesture_dsp_load2(n0 + i);
+        const uint32_t p2 = gesture_dsp_load2(n2 + i);
+        const uint32_t sum = gesture_dsp_sadd16(p0, p2);
+        uint32_t r;
+        if (sum == gesture_dsp_qadd16(p0, p2)) {
+            const uint32_t p1 = gesture_dsp_load2(n1 + i);
+            const int32_t acc0 = (int32_t)gesture_dsp_smlad(gesture_dsp_pack_low(sum, p1), coef, 0);
+            const int32_t acc1 = (int32_t)gesture_dsp_smlad(gesture_dsp_pack_high(sum, p1), coef, 0);
+            r = gesture_dsp_pack_low((uint16_t)gesture_dsp_div_pow2(acc0, shift), (uint16_t)gesture_dsp_div_pow2(acc1, shift));
+            gesture_dsp_store2(out + i, r);
+        }
+        else {
+            gesture_window3_q15_scalar(n0, n1, n2, out, i + 2, a, i);
+            r = gesture_dsp_load2(out + i);
+        }
+        vmax = gesture_dsp_max16x2(r, vmax);
+    }
+    int max_pixel = (i > 0) ? gesture_dsp_hmax16x2(vmax) : -99999;
+    const int tail_max = gesture_window3_q15_scalar(n0, n1, n2, out, n, a, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+// Two pixels per iteration: paired int16 loads and stores and the branch-free running maximum. The EMA
+// state is 32 bit, so each filter step stays one 32 bit multiply-accumulate per pixel; TrackInput (short
+// alpha 1.0) is decided once instead of per pixel.
+template <bool TrackInput>
+inline int gesture_subtract_background_q15_dsp_run(const int16_t *in, int32_t *fg, int32_t *bg, int16_t *out, const unsigned int n,
+                                                   const int32_t a_short, const int32_t a_long)
+{
+    uint32_t vmax = 0x80008000u;
+    unsigned int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const uint32_t p = gesture_dsp_load2(in + i);
+        const int32_t x0 = (int16_t)p, x1 = (int16_t)(p >> 16);
+        bg[i] += a_long * (x0 - gesture_q15_state_to_pixel(bg[i]));
+        bg[i + 1] += a_long * (x1 - gesture_q15_state_to_pixel(bg[i + 1]));
+        if (TrackInput) {
+            fg[i] = x0 * 32768;
+            fg[i + 1] = x1 * 32768;
+        }
+        else {
+            fg[i] += a_short * (x0 - gesture_q15_state_to_pixel(fg[i]));
+            fg[i + 1] += a_short * (x1 - gesture_q15_state_to_pixel(fg[i + 1]));
+        }
+        const uint32_t r = gesture_dsp_pack_low((uint16_t)(int16_t)((fg[i] - bg[i]) / 32768), (uint16_t)(int16_t)((fg[i + 1] - bg[i + 1]) / 32768));
+        gesture_dsp_store2(out + i, r);
+        vmax = gesture_dsp_max16x2(r, vmax);
+    }
+    int max_pixel = (i > 0) ? gesture_dsp_hmax16x2(vmax) : -99999;
+    const int tail_max = gesture_subtract_background_q15_scalar(in, fg, bg, out, n, a_short, a_long, i);
+    return (tail_max > max_pixel) ? tail_max : max_pixel;
+}
+
+inline int gesture_subtract_background_q15_dsp(const int16_t *in, int32_t *fg, int32_t *bg, int16_t *out, const unsigned int n,
+                                               const int32_t a_short, const int32_t a_long)
+{
+    if (a_short >= 32768) return gesture_subtract_background_q15_dsp_run<true>(in, fg, bg, out, n, a_short, a_long);
+    return gesture_subtract_background_q15_dsp_run<false>(in, fg, bg, out, n, a_short, a_long);
+}
+
+inline int gesture_window3_q15(const int16_t *n0, const int16_t *n1, const int16_t *n2, int16_t *out, const unsigned int n, const int32_t a)
+{
+#if GESTURE_LIB_DSP
+    return gesture_window3_q15_dsp(n0, n1, n2, out, n, a);
+#else
+    return gesture_window3_q15_scalar(n0, n1, n2, out, n, a);
+#endif
+}
+
+inline int gesture_subtract_background_q15(const int16_t *in, int32_t *fg, int32_t *bg, int16_t *out, const unsigned int n,
+                                           const int32_t a_short, const int32_t a_long)
+{
+#if GESTURE_LIB_DSP
+    return gesture_subtract_background_q15_dsp(in, fg, bg, out, n, a_short, a_long);
+#else
+    return gesture_subtract_background_q15_scalar(in, fg, bg, out, n, a_short, a_long);
+#endif
+}
+
+
+#endif  // __GESTURE_LIB_SIMD_H__
@@ -0,0 +1,829 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Host benchmark for gesture_lib
+*
+* Times each processing stage of gesture_lib (noiseWindow3Filter, subtractBackground, interpn,
+* zeroPixelsBelowThreshold, calcCenterOfMass) individually and the full processGesture() call
+* end-to-end on a deterministic sequence of synthetic 10x6 frames. processGestureBatch() is timed
+* over the whole sequence and checked against processGesture() frame by frame.
+*
+* --verify only runs the equivalence checks: processGestureBatch() against processGesture(), and the
+* SSE2/AVX2/NEON filter kernels and the Cortex-M DSP Q15 filters (gesture_lib_simd.h) against the scalar loops, on the
+* synthetic frames and on random ones, the region of interest processing against the whole frame, and
+* the temporal filters (gesture_filter_bank.h) with template coefficients against their run time versions.
+* It exits with 1 on any difference.
+*
+* gesture_bench_profile is built with the stage profiler (GESTURE_PROFILE, stage_profiler.h) and
+* also prints its report; its timings against gesture_bench show the profiling overhead.
+*
+* --scenes runs gesture_lib on synthetic scenes (synthetic_scene) against their ground truth: swipes
+* and hovers with gain mismatch, ambient drift, noise and saturation, rendered and processed in chunks
+* so any number of frames fits in memory. It reports the render and processGestureBatch() throughput,
+* the centroid error, how many frames after the hand comes into view a gesture is detected, and the
+* events reported against the gesture labels. The benchmark run ends with a short scene report.
+*
+* Usage: gesture_bench [frames] [repeats]
+*        gesture_bench --verify [frames]
+*        gesture_bench --scenes [frames] [seed]
+*/
+
+#include "gesture_lib.h"
+#include "gesture_reference.h"
+#include "synthetic_frames.h"
+
+#include <chrono>
+#include <vector>
+
+#define BENCH_INTERP_PIXELS         (((BENCH_SENSOR_COLS-1)*INTERP_FACTOR+1) * ((BENCH_SENSOR_ROWS-1)*INTERP_FACTOR+1))
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Prevents the compiler from discarding results of the timed loops
+static volatile int32_t bench_sink;
+
+/*
+* Runs the vector filter kernels (SSE2/AVX2/NEON float, Cortex-M DSP Q15) and their scalar versions on the
+* same frames with a few filter settings and returns the number of frames where any output pixel,
+* filter state or maximum differs. On the host the DSP kernel runs on the portable versions of the
+* DSP instructions, so this checks the kernel logic the target runs.
+*/
+static unsigned int verifyKernels(const std::vector<int16_t> &frames, const unsigned int nframes)
+{
+    static const float alphas[][2] = {{WINDOW_FILTER_ALPHA, BACKGROUND_FILTER_ALPHA}, {0.3F, 0.05F}, {0.9F, 0.5F}};
+    const float short_alpha[] = {LOW_PASS_FILTER_ALPHA, 0.7F, 0.3F};
+    const int16_t *f0 = &frames[0];
+    unsigned int mismatches = 0;
+
+    for (unsigned int s = 0; s < sizeof(alphas) / sizeof(alphas[0]); s++) {
+        const float window_alpha = alphas[s][0], long_alpha = alphas[s][1];
+        int16_t out[BENCH_SENSOR_PIXELS], out_scalar[BENCH_SENSOR_PIXELS];
+        float fg[BENCH_SENSOR_PIXELS], bg[BENCH_SENSOR_PIXELS], fg_scalar[BENCH_SENSOR_PIXELS], bg_scalar[BENCH_SENSOR_PIXELS];
+        int32_t fg_q15[BENCH_SENSOR_PIXELS], bg_q15[BENCH_SENSOR_PIXELS], fg_q15_scalar[BENCH_SENSOR_PIXELS], bg_q15_scalar[BENCH_SENSOR_PIXELS];
+        for (unsigned int i = 0; i < BENCH_SENSOR_PIXELS; i++) {
+            fg[i] = bg[i] = fg_scalar[i] = bg_scalar[i] = f0[i];
+            fg_q15[i] = bg_q15[i] = fg_q15_scalar[i] = bg_q15_scalar[i] = (int32_t)f0[i] * 32768;
+        }
+
+        for (unsigned int f = 2; f < nframes; f++) {
+            const int16_t *n0 = f0 + (f - 2) * BENCH_SENSOR_PIXELS, *n1 = n0 + BENCH_SENSOR_PIXELS, *n2 = n1 + BENCH_SENSOR_PIXELS;
+            bool ok = true;
+
+            int m = gesture_window3(n0, n1, n2, out, BENCH_SENSOR_PIXELS, window_alpha);
+            int m_scalar = gesture_window3_scalar(n0, n1, n2, out_scalar, BENCH_SENSOR_PIXELS, window_alpha);
+            ok = ok && m == m_scalar && memcmp(out, out_scalar, sizeof(out)) == 0;
+
+            m = gesture_subtract_background(n2, fg, bg, out, BENCH_SENSOR_PIXELS, short_alpha[s], long_alpha);
+            m_scalar = gesture_subtract_background_scalar(n2, fg_scalar, bg_scalar, out_scalar, BENCH_SENSOR_PIXELS, short_alpha[s], long_alpha);
+            ok = ok && m == m_scalar && memcmp(out, out_scalar, sizeof(out)) == 0 && memcmp(fg, fg_scalar, sizeof(fg)) == 0 &&
+                 memcmp(bg, bg_scalar, sizeof(bg)) == 0;
+
+            m = gesture_window3_q15_dsp(n0, n1, n2, out, BENCH_SENSOR_PIXELS, GESTURE_FLOAT_TO_Q15(window_alpha));
+            m_scalar = gesture_window3_q15_scalar(n0, n1, n2, out_scalar, BENCH_SENSOR_PIXELS, GESTURE_FLOAT_TO_Q15(window_alpha));
+            ok = ok && m == m_scalar && memcmp(out, out_scalar, sizeof(out)) == 0;
+
+            m = gesture_subtract_background_q15_dsp(n2, fg_q15, bg_q15, out, BENCH_SENSOR_PIXELS,
+                                                    GESTURE_FLOAT_TO_Q15(short_alpha[s]), GESTURE_FLOAT_TO_Q15(long_alpha));
+            m_scalar = gesture_subtract_background_q15_scalar(n2, fg_q15_scalar, bg_q15_scalar, out_scalar, BENCH_SENSOR_PIXELS,
+                                                              GESTURE_FLOAT_TO_Q15(short_alpha[s]), GESTURE_FLOAT_TO_Q15(long_alpha));
+            ok = ok && m == m_scalar && memcmp(out, out_scalar, sizeof(out)) == 0 && memcmp(fg_q15, fg_q15_scalar, sizeof(fg_q15)) == 0 &&
+                 memcmp(bg_q15, bg_q15_scalar, sizeof(bg_q15)) == 0;
+
+            if (!ok) mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/*
+* Scene metrics, accumulated frame by frame against the ground truth
+*/
+class scene_stats
+{
+public:
+    void add(const uint32_t f, const synthetic_truth &truth, const gesture_lib::DynamicGestureResult &r)
+    {
+        if (truth.gesture != _gesture) {
+            finishGesture();
+            _gesture = truth.gesture;
+            _label = truth.label;
+            _first_present = _detected = _last_present = _event_frame = UINT32_MAX;
+            _event = gesture_lib::GEST_NONE;
+        }
+
+        const bool active = r.state == gesture_lib::GESTURE_IN_PROGRESS;
+        if (truth.present) {
+            if (_first_present == UINT32_MAX) _first_present = f;
+            _last_present = f;
+        }
+        else if (active && truth.label == SYNTHETIC_NONE) {
+            false_active++;
+        }
+        if (active && _first_present != UINT32_MAX && _detected == UINT32_MAX) _detected = f;
+
+        if (r.event != gesture_lib::GEST_NONE) {
+            if (_gesture == 0 || _event != gesture_lib::GEST_NONE) spurious_events++;
+            else {
+                _event = r.event;
+                _event_frame = f;
+            }
+        }
+
+        if (active && truth.present && truth.inside) {
+            const float dx = fabsf(r.cmx - truth.x);
+            const float dy = fabsf(r.cmy / (float)DY_PIXEL_SCALE - truth.y);
+            centroid_frames++;
+            sum_dx += dx;
+            sum_dy += dy;
+            max_dx = fmaxf(max_dx, dx);
+            max_dy = fmaxf(max_dy, dy);
+        }
+    }
+
+    // Closes the last gesture
+    void finish() { finishGesture(); _gesture = UINT32_MAX; }
+
+    void print() const
+    {
+        const double n = centroid_frames > 0 ? (double)centroid_frames : 1.0;
+        printf("centroid error over %u frames (hand over the array): mean |dx| %.3f max %.3f, mean |dy| %.3f max %.3f pixels\n",
+               centroid_frames, sum_dx / n, max_dx, sum_dy / n, max_dy);
+        printf("detection: %u of %u gestures, latency from coming into view mean %.2f max %u frames; %u active frames without a hand\n",
+               detected, gestures, detected > 0 ? (double)sum_latency / detected : 0.0, max_latency, false_active);
+        printf("events:");
+        static const char *names[SYNTHETIC_NUM_LABELS] = {"none", "left", "right", "up", "down", "hover"};
+        for (unsigned int l = 1; l < SYNTHETIC_NUM_LABELS; l++) {
+            printf(" %s %u/%u", names[l], correct[l], labelled[l]);
+        }
+        printf(" correct; %u wrong, %u missed, %u spurious; %.2f frames from leaving view to the event (mean)\n", wrong, missed,
+               spurious_events, correct_total > 0 ? (double)sum_event_delay / correct_total : 0.0);
+    }
+
+    unsigned int gestures = 0, detected = 0, max_latency = 0, false_active = 0;
+    uint64_t sum_latency = 0;
+    unsigned int labelled[SYNTHETIC_NUM_LABELS] = {0}, correct[SYNTHETIC_NUM_LABELS] = {0};
+    unsigned int correct_total = 0, wrong = 0, missed = 0, spurious_events = 0;
+    int64_t sum_event_delay = 0;          // Negative when the event comes while the hand is still in view
+    unsigned int centroid_frames = 0;
+    double sum_dx = 0.0, sum_dy = 0.0;
+    float max_dx = 0.0f, max_dy = 0.0f;
+
+private:
+    void finishGesture()
+    {
+        if (_gesture == 0 || _gesture == UINT32_MAX || _first_present == UINT32_MAX) return;
+        gestures++;
+        labelled[_label]++;
+        if (_detected != UINT32_MAX) {
+            const unsigned int latency = _detected - _first_present;
+            detected++;
+            sum_latency += latency;
+            max_latency = std::max(max_latency, latency);
+        }
+        // gesture_lib reports a hover as a click; GestureEvent and synthetic_label share their values
+        if (_event == gesture_lib::GEST_NONE) missed++;
+        else if (_event == _label) {
+            correct[_label]++;
+            correct_total++;
+            sum_event_delay += (int64_t)_event_frame - (int64_t)_last_present;
+        }
+        else wrong++;
+    }
+
+    uint32_t _gesture = 0;
+    uint8_t _label = SYNTHETIC_NONE;
+    uint32_t _first_present = UINT32_MAX, _detected = UINT32_MAX, _last_present = UINT32_MAX, _event_frame = UINT32_MAX;
+    uint8_t _event = gesture_lib::GEST_NONE;
+};
+
+static_assert((int)SYNTHETIC_HOVER == (int)gesture_lib::GEST_CLICK && (int)SYNTHETIC_SWIPE_LEFT == (int)gesture_lib::GEST_LEFT,
+              "synthetic labels follow GestureEvent");
+
+/*
+* Renders nframes of a synthetic scene in chunks, processes each chunk with processGestureBatch() and
+* prints the throughput and the metrics against the ground truth
+*/
+static void reportScenes(const unsigned int nframes, const uint32_t seed)
+{
+    const unsigned int CHUNK = 16384;
+    synthetic_scene_config config = syntheticSceneDefaults();
+    config.seed = seed;
+    synthetic_scene scene(config);
+    static gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+    g.resetGesture();
+
+    std::vector<int16_t> frames(CHUNK * BENCH_SENSOR_PIXELS);
+    std::vector<synthetic_truth> truth(CHUNK);
+    std::vector<gesture_lib::DynamicGestureResult> results(CHUNK);
+    scene_stats stats;
+    double render_ns = 0.0, process_ns = 0.0;
+
+    for (unsigned int done = 0; done < nframes; ) {
+        const unsigned int n = std::min(CHUNK, nframes - done);
+        bench_clock::time_point t0 = bench_clock::now();
+        for (unsigned int f = 0; f < n; f++) scene.render(&frames[f * BENCH_SENSOR_PIXELS], truth[f]);
+        bench_clock::time_point t1 = bench_clock::now();
+        g.processGestureBatch(&frames[0], n, &results[0]);
+        bench_clock::time_point t2 = bench_clock::now();
+        render_ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        process_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+
+        for (unsigned int f = 0; f < n; f++) stats.add(done + f, truth[f], results[f]);
+        done += n;
+    }
+    stats.finish();
+
+    printf("synthetic scenes: %u frames, seed %u, peak %.0f, sigma %.1f, %.2f pixels/frame, gain mismatch %.0f%%, drift +/-%.0f\n",
+           nframes, (unsigned int)seed, config.peak, config.sigma, config.speed, config.gain_mismatch * 100.0f, config.drift_amplitude);
+    printf("render %.1f ns/frame (%.0f frames/s), processGestureBatch %.1f ns/frame (%.0f frames/s)\n", render_ns / nframes,
+           render_ns > 0 ? 1e9 * nframes / render_ns : 0.0, process_ns / nframes, process_ns > 0 ? 1e9 * nframes / process_ns : 0.0);
+    stats.print();
+}
+
+/*
+* Temporal filters (gesture_filter_bank.h) with the coefficients as template arguments; the bench
+* sets the same coefficients on the run time versions. The biquad is a 2nd order Butterworth low pass
+* at 0.1 of the frame rate.
+*/
+#define BENCH_BIQUAD_B0             (0.0675F)
+#define BENCH_BIQUAD_B1             (0.1349F)
+#define BENCH_BIQUAD_B2             (0.0675F)
+#define BENCH_BIQUAD_A1             (-1.1430F)
+#define BENCH_BIQUAD_A2             (0.4128F)
+
+typedef gesture_fir_filter<gesture_lib::PixelArraySize, GESTURE_FLOAT_TO_Q15(0.25F), GESTURE_FLOAT_TO_Q15(0.5F),
+                           GESTURE_FLOAT_TO_Q15(0.25F)> bench_fir_filter;
+typedef gesture_biquad_filter<gesture_lib::PixelArraySize, GESTURE_FLOAT_TO_Q14(BENCH_BIQUAD_B0), GESTURE_FLOAT_TO_Q14(BENCH_BIQUAD_B1),
+                              GESTURE_FLOAT_TO_Q14(BENCH_BIQUAD_B2), GESTURE_FLOAT_TO_Q14(BENCH_BIQUAD_A1),
+                              GESTURE_FLOAT_TO_Q14(BENCH_BIQUAD_A2)> bench_biquad_filter;
+typedef gesture_ema_filter<gesture_lib::PixelArraySize, 2> bench_ema_filter;
+
+// The bench FIR padded to more taps than the default frame history, so it runs on its own delay line
+#define BENCH_LONG_FIR_TAPS         (5u)
+typedef gesture_fir_filter<gesture_lib::PixelArraySize, GESTURE_FLOAT_TO_Q15(0.25F), GESTURE_FLOAT_TO_Q15(0.5F),
+                           GESTURE_FLOAT_TO_Q15(0.25F), 0, 0> bench_long_fir_filter;
+
+static void setBenchCoefficients(gesture_fir_filter_runtime<gesture_lib::PixelArraySize> &fir,
+                                 gesture_biquad_filter_runtime<gesture_lib::PixelArraySize> &biquad,
+                                 gesture_ema_filter_runtime<gesture_lib::PixelArraySize> &ema)
+{
+    static const float fir_coeffs[] = {0.25F, 0.5F, 0.25F};
+    fir.set_coefficients(fir_coeffs, 3);
+    biquad.set_coefficients(BENCH_BIQUAD_B0, BENCH_BIQUAD_B1, BENCH_BIQUAD_B2, BENCH_BIQUAD_A1, BENCH_BIQUAD_A2);
+    ema.set_alpha(0.25F);
+}
+
+/*
+* Friend of gesture_lib so the private processing stages can be called on their own
+*/
+class gesture_lib_bench
+{
+public:
+    gesture_lib_bench(const std::vector<int16_t> &frames, unsigned int nframes, unsigned int repeats):
+        _frames(frames), _nframes(nframes), _repeats(repeats),
+        _foreground(nframes * BENCH_SENSOR_PIXELS), _interp(nframes * BENCH_INTERP_PIXELS),
+        _thresholded(nframes * BENCH_INTERP_PIXELS), _maxpixel(nframes)
+    {
+        prepareStageInputs();
+    }
+
+    // Only the equivalence checks, for gesture_bench --verify. Returns the number of mismatches.
+    unsigned int verify()
+    {
+        std::vector<int16_t> random(_nframes * BENCH_SENSOR_PIXELS), full_range(_nframes * BENCH_SENSOR_PIXELS);
+        uint32_t seed = 12345;
+        for (size_t i = 0; i < random.size(); i++) {
+            seed = seed * 1664525u + 1013904223u;
+            full_range[i] = (int16_t)((int32_t)(seed >> 16) - 32768);
+            random[i] = full_range[i] / 2;
+        }
+
+        unsigned int mismatches = reportBatchMismatches();
+        // Full range frames overflow the halfword outer tap sum of the DSP window filter
+        unsigned int random_mismatches = verifyKernels(random, _nframes) + verifyKernels(full_range, _nframes);
+        printf("filter kernels vs scalar on random and full range random frames: %u mismatching frames\n", random_mismatches);
+        unsigned int roi_mismatches = regionOfInterestMismatches(&_frames[0]) + regionOfInterestMismatches(&random[0]);
+        printf("regionOfInterest vs whole frame (and fast sector energy) on synthetic and random frames: %u mismatching frames\n", roi_mismatches);
+        unsigned int filter_mismatches = temporalFilterMismatches(&_frames[0]) + temporalFilterMismatches(&random[0]);
+        printf("temporal filters, template vs run time coefficients on synthetic and random frames, FIR saturation: %u mismatching frames\n",
+               filter_mismatches);
+        return mismatches + random_mismatches + roi_mismatches + filter_mismatches;
+    }
+
+    void run()
+    {
+        printf("gesture_lib host benchmark: %u frames x %u repeats, INTERP_FACTOR %d, %s\n", _nframes, _repeats, INTERP_FACTOR,
+               GESTURE_LIB_FIXED_POINT ? "fixed point" : "float");
+        printf("gesture_lib instance size: %u bytes\n", (unsigned int)sizeof(gesture_lib));
+        printf("%-32s %12s %14s\n", "stage", "ns/frame", "frames/s");
+
+        double copy_small = timeCopy(&_frames[0], BENCH_SENSOR_PIXELS);
+        double copy_interp = timeCopy(&_interp[0], BENCH_INTERP_PIXELS);
+        report("frame copy (baseline)", copy_small);
+
+        report("noiseWindow3Filter", timeNoiseWindow3Filter() - copy_small);
+        {
+            bench_fir_filter fir;
+            bench_biquad_filter biquad;
+            bench_ema_filter ema;
+            gesture_fir_filter_runtime<gesture_lib::PixelArraySize> fir_rt;
+            gesture_biquad_filter_runtime<gesture_lib::PixelArraySize> biquad_rt;
+            gesture_ema_filter_runtime<gesture_lib::PixelArraySize> ema_rt;
+            setBenchCoefficients(fir_rt, biquad_rt, ema_rt);
+            report("  FIR 3 tap (template)", timeNoiseWindow3Filter(&fir) - copy_small);
+            report("  FIR 3 tap (run time)", timeNoiseWindow3Filter(&fir_rt) - copy_small);
+            report("  biquad (template)", timeNoiseWindow3Filter(&biquad) - copy_small);
+            report("  biquad (run time)", timeNoiseWindow3Filter(&biquad_rt) - copy_small);
+            report("  EMA 1/4 (template)", timeNoiseWindow3Filter(&ema) - copy_small);
+            report("  EMA 1/4 (run time)", timeNoiseWindow3Filter(&ema_rt) - copy_small);
+        }
+        report("subtractBackground", timeSubtractBackground() - copy_small);
+        report("interpn", timeInterpn() - copy_small);
+        report("zeroPixelsBelowThreshold x2", timeZeroPixelsBelowThreshold() - copy_interp);
+        report("calcCenterOfMass", timeCalcCenterOfMass() - copy_interp);
+        report("interpThresholdCenterOfMass", timeInterpThresholdCenterOfMass() - copy_small);
+        report("processGesture (end-to-end)", timeProcessGesture(false) - copy_small);
+        report("processGesture (no ROI)", timeProcessGesture(false, gesture_lib::GEST_DYNAMIC, false) - copy_small);
+        report("processGesture (keepInterpFrame)", timeProcessGesture(true) - copy_small);
+        report("processGesture (GEST_DYNAMIC_FAST)", timeProcessGesture(false, gesture_lib::GEST_DYNAMIC_FAST) - copy_small);
+        report("processGesture (GEST_TRACKING)", timeProcessGesture(false, gesture_lib::GEST_TRACKING) - copy_small);
+        report("processGestureBatch", timeProcessGestureBatch());
+
+        reportAccuracy();
+        reportFastCentroidError();
+        reportBatchMismatches();
+#if GESTURE_PROFILE
+        reportProfile();
+#endif
+    }
+
+private:
+#if GESTURE_PROFILE
+    // processGesture() with keepInterpFrame, so every gesture_lib stage is timed on its own
+    void reportProfile()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        g.keepInterpFrame = true;
+        gesture_profiler().reset();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                GESTURE_PROFILE_BEGIN(t_frame);
+                g.processGesture(WINDOW_FILTER_ALPHA, gesture_lib::GEST_TRACKING);
+                GESTURE_PROFILE_END(PROFILE_FRAME, t_frame);
+            }
+        }
+        printf("stage profiler, processGesture (keepInterpFrame, GEST_TRACKING):\n");
+        gesture_profiler().print();
+    }
+#endif
+
+    // Runs the real pipeline once so every stage can be timed on the input it would see in use
+    void prepareStageInputs()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        for (unsigned int f = 0; f < _nframes; f++) {
+            memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            g.noiseWindow3Filter(WINDOW_FILTER_ALPHA);
+            if (g._reset_flag) {
+                for (unsigned int i = 0; i < BENCH_SENSOR_PIXELS; i++) {
+                    g._foreground_pixels[i] = GESTURE_PIXEL_TO_STATE(g.pixels[i]);
+                    g._background_pixels[i] = GESTURE_PIXEL_TO_STATE(g.pixels[i]);
+                }
+                g._reset_flag = false;
+            }
+            g.subtractBackground(LOW_PASS_FILTER_ALPHA, BACKGROUND_FILTER_ALPHA);
+            memcpy(&_foreground[f * BENCH_SENSOR_PIXELS], g.pixels, BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            _maxpixel[f] = g.MaxPixelValue;
+            g.interpn();
+            memcpy(&_interp[f * BENCH_INTERP_PIXELS], g._interp_pixels.data(), BENCH_INTERP_PIXELS * sizeof(int16_t));
+            g.zeroPixelsBelowThreshold(g.MaxPixelValue/ZERO_CLAMP_THRESHOLD_FACTOR);
+            g.zeroPixelsBelowThreshold(ZERO_CLAMP_THRESHOLD);
+            memcpy(&_thresholded[f * BENCH_INTERP_PIXELS], g._interp_pixels.data(), BENCH_INTERP_PIXELS * sizeof(int16_t));
+        }
+    }
+
+    const int16_t *frame(unsigned int f) const { return &_frames[f * BENCH_SENSOR_PIXELS]; }
+
+    double elapsedNsPerFrame(bench_clock::time_point start) const
+    {
+        std::chrono::duration<double, std::nano> ns = bench_clock::now() - start;
+        return ns.count() / ((double)_nframes * _repeats);
+    }
+
+    double timeCopy(const int16_t *src, unsigned int npixels)
+    {
+        std::vector<int16_t> dst(npixels);
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(&dst[0], src + f * npixels, npixels * sizeof(int16_t));
+                bench_sink = dst[f % npixels];
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    // The window filter, or filter in its place
+    double timeNoiseWindow3Filter(gesture_temporal_filter<gesture_lib::PixelArraySize> *filter = NULL)
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        g.setTemporalFilter(filter);
+        memcpy(g.pixels, frame(0), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+        g.noiseWindow3Filter(WINDOW_FILTER_ALPHA);
+        g._reset_flag = false;
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                g.noiseWindow3Filter(WINDOW_FILTER_ALPHA);
+                bench_sink = g.MaxPixelValue;
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    double timeSubtractBackground()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        for (unsigned int i = 0; i < BENCH_SENSOR_PIXELS; i++) {
+            g._foreground_pixels[i] = GESTURE_PIXEL_TO_STATE(frame(0)[i]);
+            g._background_pixels[i] = GESTURE_PIXEL_TO_STATE(frame(0)[i]);
+        }
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                g.subtractBackground(LOW_PASS_FILTER_ALPHA, BACKGROUND_FILTER_ALPHA);
+                bench_sink = g.MaxPixelValue;
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    double timeInterpn()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g.pixels, &_foreground[f * BENCH_SENSOR_PIXELS], BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                g.interpn();
+                bench_sink = g._interp_pixels[f % BENCH_INTERP_PIXELS];
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    double timeZeroPixelsBelowThreshold()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g._interp_pixels.data(), &_interp[f * BENCH_INTERP_PIXELS], BENCH_INTERP_PIXELS * sizeof(int16_t));
+                bench_sink = g.zeroPixelsBelowThreshold(_maxpixel[f]/ZERO_CLAMP_THRESHOLD_FACTOR);
+                bench_sink = g.zeroPixelsBelowThreshold(ZERO_CLAMP_THRESHOLD);
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    double timeCalcCenterOfMass()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        float cmx, cmy;
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g._interp_pixels.data(), &_thresholded[f * BENCH_INTERP_PIXELS], BENCH_INTERP_PIXELS * sizeof(int16_t));
+                int32_t totalmass = 0;
+                g.calcCenterOfMass(&cmx, &cmy, &totalmass);
+                bench_sink = totalmass;
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    double timeInterpThresholdCenterOfMass()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        float cmx, cmy;
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g.pixels, &_foreground[f * BENCH_SENSOR_PIXELS], BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                int32_t totalmass = 0;
+                g.interpThresholdCenterOfMass(_maxpixel[f]/ZERO_CLAMP_THRESHOLD_FACTOR, ZERO_CLAMP_THRESHOLD, &cmx, &cmy, &totalmass);
+                bench_sink = totalmass;
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    double timeProcessGesture(const bool keep_interp_frame, gesture_lib::GestureType type = gesture_lib::GEST_DYNAMIC,
+                              const bool region_of_interest = true)
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        g.keepInterpFrame = keep_interp_frame;
+        g.regionOfInterest = region_of_interest;
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                g.processGesture(WINDOW_FILTER_ALPHA, type);
+                bench_sink = g.dynamicResult.CoM_Intensity;
+            }
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    double timeProcessGestureBatch()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        std::vector<gesture_lib::DynamicGestureResult> results(_nframes);
+
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned int r = 0; r < _repeats; r++) {
+            g.processGestureBatch(frame(0), _nframes, &results[0]);
+            bench_sink = results[_nframes - 1].CoM_Intensity;
+        }
+        return elapsedNsPerFrame(start);
+    }
+
+    // processGestureBatch() in uneven chunks against processGesture() frame by frame, and the vector
+    // filter kernels against their scalar versions. Both must match exactly.
+    unsigned int reportBatchMismatches()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        gesture_lib batch(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        std::vector<gesture_lib::DynamicGestureResult> results(_nframes);
+        unsigned int mismatches = 0;
+
+        for (unsigned int f = 0, chunk = 1; f < _nframes; f += chunk, chunk = chunk % 7 + 1) {
+            if (chunk > _nframes - f) chunk = _nframes - f;
+            batch.processGestureBatch(frame(f), chunk, &results[f], WINDOW_FILTER_ALPHA, gesture_lib::GEST_TRACKING);
+        }
+        for (unsigned int f = 0; f < _nframes; f++) {
+            memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            g.processGesture(WINDOW_FILTER_ALPHA, gesture_lib::GEST_TRACKING);
+            const gesture_lib::DynamicGestureResult &a = g.dynamicResult, &b = results[f];
+            if (a.state != b.state || a.maxpixel != b.maxpixel || memcmp(&a.cmx, &b.cmx, sizeof(float)) != 0 ||
+                memcmp(&a.cmy, &b.cmy, sizeof(float)) != 0 || a.CoM_Intensity != b.CoM_Intensity || a.n_sample != b.n_sample ||
+                a.event != b.event || memcmp(&a.event_confidence, &b.event_confidence, sizeof(float)) != 0) {
+                mismatches++;
+            }
+        }
+        if (memcmp(&g.trackingResult, &batch.trackingResult, sizeof(g.trackingResult)) != 0) mismatches++;
+        for (uint16_t k = 0; k < gesture_lib::FrameHistory::depth; k++) {
+            if (memcmp(g.frameHistory().newest(k), batch.frameHistory().newest(k), BENCH_SENSOR_PIXELS * sizeof(int16_t)) != 0) mismatches++;
+        }
+
+        const unsigned int kernel_mismatches = verifyKernels(_frames, _nframes);
+        printf("processGestureBatch vs processGesture: %u mismatching frames; filter kernels vs scalar: %u mismatching frames\n",
+               mismatches, kernel_mismatches);
+        return mismatches + kernel_mismatches;
+    }
+
+    // processGesture() with the region of interest window against the whole frame; must match exactly.
+    // The sector energy of GEST_DYNAMIC_FAST, summed in its own pass, must match as well.
+    unsigned int regionOfInterestMismatches(const int16_t *frames)
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        gesture_lib whole(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        gesture_lib fast(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        whole.regionOfInterest = false;
+        unsigned int mismatches = 0;
+
+        for (unsigned int f = 0; f < _nframes; f++) {
+            memcpy(g.pixels, frames + f * BENCH_SENSOR_PIXELS, BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            memcpy(whole.pixels, frames + f * BENCH_SENSOR_PIXELS, BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            memcpy(fast.pixels, frames + f * BENCH_SENSOR_PIXELS, BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            g.processGesture(WINDOW_FILTER_ALPHA, gesture_lib::GEST_DYNAMIC);
+            whole.processGesture(WINDOW_FILTER_ALPHA, gesture_lib::GEST_DYNAMIC);
+            fast.processGesture(WINDOW_FILTER_ALPHA, gesture_lib::GEST_DYNAMIC_FAST);
+            const gesture_lib::DynamicGestureResult &a = g.dynamicResult, &b = whole.dynamicResult, &c = fast.dynamicResult;
+            if (a.state != b.state || memcmp(&a.cmx, &b.cmx, sizeof(float)) != 0 || memcmp(&a.cmy, &b.cmy, sizeof(float)) != 0 ||
+                a.CoM_Intensity != b.CoM_Intensity || a.event != b.event || a.peak_sector != b.peak_sector ||
+                memcmp(a.sector_energy, b.sector_energy, sizeof(a.sector_energy)) != 0 || c.peak_sector != b.peak_sector ||
+                memcmp(c.sector_energy, b.sector_energy, sizeof(c.sector_energy)) != 0) {
+                mismatches++;
+            }
+        }
+        return mismatches;
+    }
+
+    // Each temporal filter with template coefficients against the run time version with the same
+    // coefficients, as the window filter stage of processGesture(); must match exactly. The FIR padded
+    // with zero taps beyond the frame history, on its own delay line, must match the short one.
+    unsigned int temporalFilterMismatches(const int16_t *frames)
+    {
+        bench_fir_filter fir;
+        bench_biquad_filter biquad;
+        bench_ema_filter ema;
+        bench_long_fir_filter long_fir;
+        gesture_fir_filter_runtime<gesture_lib::PixelArraySize> fir_rt;
+        gesture_biquad_filter_runtime<gesture_lib::PixelArraySize> biquad_rt;
+        gesture_ema_filter_runtime<gesture_lib::PixelArraySize> ema_rt;
+        gesture_fir_filter_runtime<gesture_lib::PixelArraySize, BENCH_LONG_FIR_TAPS> long_fir_rt;
+        setBenchCoefficients(fir_rt, biquad_rt, ema_rt);
+        static const float long_fir_coeffs[] = {0.25F, 0.5F, 0.25F};
+        long_fir_rt.set_coefficients(long_fir_coeffs, 3);
+
+        gesture_temporal_filter<gesture_lib::PixelArraySize> *filters[][2] = {{&fir, &fir_rt}, {&biquad, &biquad_rt}, {&ema, &ema_rt},
+                                                                              {&fir, &long_fir}, {&long_fir, &long_fir_rt}};
+        unsigned int mismatches = 0;
+
+        for (unsigned int k = 0; k < sizeof(filters) / sizeof(filters[0]); k++) {
+            gesture_lib a(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+            gesture_lib b(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+            a.setTemporalFilter(filters[k][0]);
+            b.setTemporalFilter(filters[k][1]);
+            for (unsigned int f = 0; f < _nframes; f++) {
+                memcpy(a.pixels, frames + f * BENCH_SENSOR_PIXELS, BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                memcpy(b.pixels, frames + f * BENCH_SENSOR_PIXELS, BENCH_SENSOR_PIXELS * sizeof(int16_t));
+                if (f == _nframes / 2) {
+                    a.resetGesture();
+                    b.resetGesture();
+                }
+                a.noiseWindow3Filter(WINDOW_FILTER_ALPHA);
+                b.noiseWindow3Filter(WINDOW_FILTER_ALPHA);
+                a._reset_flag = b._reset_flag = false;
+                if (a.MaxPixelValue != b.MaxPixelValue || memcmp(a.pixels, b.pixels, BENCH_SENSOR_PIXELS * sizeof(int16_t)) != 0) {
+                    mismatches++;
+                }
+            }
+        }
+
+        // A gain of 3 on full scale frames has to saturate, not overflow the sum
+        gesture_fir_filter<gesture_lib::PixelArraySize, GESTURE_FLOAT_TO_Q15_SIGNED(1.0F), GESTURE_FLOAT_TO_Q15_SIGNED(1.0F),
+                           GESTURE_FLOAT_TO_Q15_SIGNED(1.0F)> gain3;
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        g.setTemporalFilter(&gain3);
+        for (unsigned int f = 0; f < 3; f++) {
+            for (unsigned int i = 0; i < BENCH_SENSOR_PIXELS; i++) g.pixels[i] = (i & 1) ? INT16_MAX : INT16_MIN;
+            g.noiseWindow3Filter(WINDOW_FILTER_ALPHA);
+            g._reset_flag = false;
+        }
+        for (unsigned int i = 0; i < BENCH_SENSOR_PIXELS; i++) {
+            if (g.pixels[i] != ((i & 1) ? INT16_MAX : INT16_MIN)) {
+                mismatches++;
+                break;
+            }
+        }
+        return mismatches;
+    }
+
+    // Compares processGesture() against the float reference model frame by frame
+    void reportAccuracy()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        gesture_reference ref(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        unsigned int state_mismatch = 0, compared = 0;
+        float max_dcmx = 0.0f, max_dcmy = 0.0f, max_dmass = 0.0f;
+
+        for (unsigned int f = 0; f < _nframes; f++) {
+            memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            g.processGesture(WINDOW_FILTER_ALPHA, g.GEST_DYNAMIC);
+            const gesture_lib::DynamicGestureResult &r = ref.process(frame(f));
+
+            if (g.dynamicResult.state != r.state) {
+                state_mismatch++;
+                continue;
+            }
+            if (r.state != gesture_lib::GESTURE_IN_PROGRESS) continue;
+            compared++;
+            max_dcmx = fmaxf(max_dcmx, fabsf(g.dynamicResult.cmx - r.cmx));
+            max_dcmy = fmaxf(max_dcmy, fabsf(g.dynamicResult.cmy - r.cmy));
+            float dmass = fabsf((float)g.dynamicResult.CoM_Intensity - (float)r.CoM_Intensity) / (float)r.CoM_Intensity;
+            max_dmass = fmaxf(max_dmass, dmass);
+        }
+        printf("accuracy vs float reference: %u active frames, %u state mismatches, max |dcmx| %.4f, max |dcmy| %.4f, max dCoM_Intensity %.3f%%\n",
+               compared, state_mismatch, max_dcmx, max_dcmy, max_dmass * 100.0f);
+    }
+
+    // Error of the GEST_DYNAMIC_FAST centroid estimate against GEST_DYNAMIC, in sensor pixels
+    void reportFastCentroidError()
+    {
+        gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        gesture_lib fast(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+        unsigned int compared = 0;
+        double sum_dcmx = 0.0, sum_dcmy = 0.0, sum_dmass = 0.0;
+        float max_dcmx = 0.0f, max_dcmy = 0.0f, max_dmass = 0.0f;
+
+        for (unsigned int f = 0; f < _nframes; f++) {
+            memcpy(g.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            memcpy(fast.pixels, frame(f), BENCH_SENSOR_PIXELS * sizeof(int16_t));
+            g.processGesture(WINDOW_FILTER_ALPHA, g.GEST_DYNAMIC);
+            fast.processGesture(WINDOW_FILTER_ALPHA, fast.GEST_DYNAMIC_FAST);
+            // Only frames with an object in view
+            if (g.dynamicResult.state != gesture_lib::GESTURE_IN_PROGRESS) continue;
+            compared++;
+            float dcmx = fabsf(g.dynamicResult.cmx - fast.dynamicResult.cmx);
+            float dcmy = fabsf(g.dynamicResult.cmy - fast.dynamicResult.cmy);
+            sum_dcmx += dcmx;
+            sum_dcmy += dcmy;
+            max_dcmx = fmaxf(max_dcmx, dcmx);
+            max_dcmy = fmaxf(max_dcmy, dcmy);
+            float dmass = fabsf((float)g.dynamicResult.CoM_Intensity - (float)fast.dynamicResult.CoM_Intensity) / (float)g.dynamicResult.CoM_Intensity;
+            max_dmass = fmaxf(max_dmass, dmass);
+            sum_dmass += dmass;
+        }
+        if (compared == 0) compared = 1;
+        printf("GEST_DYNAMIC_FAST vs GEST_DYNAMIC: mean |dcmx| %.4f max %.4f, mean |dcmy| %.4f max %.4f, dCoM_Intensity mean %.2f%% max %.2f%%\n",
+               sum_dcmx / compared, max_dcmx, sum_dcmy / compared, max_dcmy, sum_dmass / compared * 100.0, max_dmass * 100.0f);
+    }
+
+    void report(const char *stage, double ns_per_frame)
+    {
+        if (ns_per_frame < 0.0) ns_per_frame = 0.0;
+        double fps = ns_per_frame > 0.0 ? 1e9 / ns_per_frame : 0.0;
+        printf("%-32s %12.1f %14.0f\n", stage, ns_per_frame, fps);
+    }
+
+    const std::vector<int16_t> &_frames;
+    const unsigned int _nframes;
+    const unsigned int _repeats;
+
+    std::vector<int16_t> _foreground;
+    std::vector<int16_t> _interp;
+    std::vector<int16_t> _thresholded;
+    std::vector<int> _maxpixel;
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--scenes") == 0) {
+        unsigned int nframes = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 0) : 1000000;
+        uint32_t seed = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1;
+        reportScenes(nframes > 0 ? nframes : 1000000, seed);
+        return 0;
+    }
+
+    unsigned int nframes = 2048;
+    unsigned int repeats = 50;
+    const bool verify = argc > 1 && strcmp(argv[1], "--verify") == 0;
+    const int arg = verify ? 2 : 1;
+
+    if (argc > arg) nframes = (unsigned int)strtoul(argv[arg], NULL, 0);
+    if (argc > arg + 1) repeats = (unsigned int)strtoul(argv[arg + 1], NULL, 0);
+    if (nframes < 3 || repeats == 0) {
+        printf("usage: %s [frames] [repeats]\n       %s --verify [frames]\n       %s --scenes [frames] [seed]\n", argv[0], argv[0],
+               argv[0]);
+        return 1;
+    }
+
+    std::vector<int16_t> frames;
+    makeSyntheticFrames(frames, nframes);
+
+    gesture_lib_bench bench(frames, nframes, repeats);
+    if (verify) {
+        unsigned int mismatches = bench.verify();
+        printf("%s\n", mismatches == 0 ? "verify: all equal" : "verify: MISMATCH");
+        return mismatches == 0 ? 0 : 1;
+    }
+    bench.run();
+    reportScenes(20000, 1);
+
+    return 0;
+}
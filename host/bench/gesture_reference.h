@@ -0,0 +1,176 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Float reference model of the gesture_lib GEST_DYNAMIC pipeline
+*
+* A straight copy of the original float implementation (window filter, EMA background subtraction,
+* two pass bilinear interpolation, double thresholding and center of mass) kept independent of
+* gesture_lib build options, so the host tools can report how far an optimised build drifts from it.
+*/
+
+#ifndef __GESTURE_REFERENCE_H__
+#define __GESTURE_REFERENCE_H__
+
+#include "gesture_lib.h"
+
+#include <vector>
+
+class gesture_reference
+{
+public:
+    gesture_reference(const unsigned int cols, const unsigned int rows, const unsigned int interp_factor = INTERP_FACTOR):
+        _cols(cols), _rows(rows), _size(cols*rows), _factor(interp_factor),
+        _icols((cols-1)*interp_factor+1), _irows((rows-1)*interp_factor+1),
+        _nwin0(_size), _nwin1(_size), _nwin2(_size), _fg(_size), _bg(_size), _pixels(_size),
+        _interp(_icols*_irows)
+    {
+    }
+
+    void reset() { _reset_flag = true; }
+
+    const gesture_lib::DynamicGestureResult &process(const int16_t frame[])
+    {
+        for (unsigned int i = 0; i < _size; i++) _pixels[i] = frame[i];
+
+        // noiseWindow3Filter(WINDOW_FILTER_ALPHA)
+        const float alpha = WINDOW_FILTER_ALPHA;
+        if (_reset_flag) {
+            for (unsigned int i = 0; i < _size; i++) _nwin0[i] = _nwin1[i] = _nwin2[i] = _pixels[i];
+            for (unsigned int i = 0; i < _size; i++) _fg[i] = _bg[i] = _pixels[i];
+            _reset_flag = false;
+        }
+        else {
+            for (unsigned int i = 0; i < _size; i++) {
+                _nwin0[i] = _nwin1[i];
+                _nwin1[i] = _nwin2[i];
+                _nwin2[i] = _pixels[i];
+                _pixels[i] = alpha * _nwin1[i] + (1-alpha)*(_nwin0[i] + _nwin2[i])/2;
+            }
+        }
+
+        // subtractBackground(LOW_PASS_FILTER_ALPHA, BACKGROUND_FILTER_ALPHA)
+        int maxpixel = -99999;
+        for (unsigned int i = 0; i < _size; i++) {
+            _bg[i] = (1.0f - BACKGROUND_FILTER_ALPHA) * _bg[i] + BACKGROUND_FILTER_ALPHA * (float)_pixels[i];
+            _fg[i] = (1.0f - LOW_PASS_FILTER_ALPHA) * _fg[i] + LOW_PASS_FILTER_ALPHA * (float)_pixels[i];
+            _pixels[i] = (int16_t)(_fg[i] - _bg[i]);
+            if (_pixels[i] > maxpixel) maxpixel = _pixels[i];
+        }
+
+        interpn();
+        zeroBelow((int)maxpixel/ZERO_CLAMP_THRESHOLD_FACTOR);
+        zeroBelow(ZERO_CLAMP_THRESHOLD);
+
+        _result = gesture_lib::DynamicGestureResult();
+        _result.maxpixel = maxpixel;
+        _result.cmx = -1.0f;
+        _result.cmy = -1.0f;
+        if (maxpixel >= (int)END_DETECTION_THRESHOLD) {
+            int cmx_number = 0, cmy_number = 0;
+            int32_t totalmass = 0;
+            for (unsigned int i = 0; i < _icols*_irows; i++) {
+                cmx_number += (i%_icols)*_interp[i];
+                cmy_number += (i/_icols)*_interp[i];
+                totalmass += _interp[i];
+            }
+            if (totalmass == 0) totalmass = 1;
+            _result.cmx = (float)cmx_number/(float)totalmass/(float)_factor;
+            _result.cmy = (float)cmy_number/(float)totalmass/(float)_factor * (float)DY_PIXEL_SCALE;
+            _result.CoM_Intensity = totalmass;
+            _result.state = gesture_lib::GESTURE_IN_PROGRESS;
+        }
+        else {
+            _result.state = gesture_lib::STATE_INACTIVE;
+        }
+        return _result;
+    }
+
+    // Background subtracted pixels of the last processed frame
+    const int16_t *pixels() const { return &_pixels[0]; }
+
+private:
+    void interpn()
+    {
+        int A, B, C, x, y;
+        float ratio = 1.0f / (float)_factor;
+        for (unsigned int i = 0; i < _rows; i++) {
+            for (unsigned int j = 0; j < _icols; j++) {
+                x = (int)(ratio * j);
+                int index = i * _cols + x;
+                if (x == (int)_cols - 1)
+                    _interp[i * _icols * _factor + j] = _pixels[index];
+                else {
+                    A = _pixels[index];
+                    B = _pixels[index + 1];
+                    float x_diff = (ratio * j) - x;
+                    _interp[i * _icols * _factor + j] = (int)(A + (B - A) * x_diff);
+                }
+            }
+        }
+        for (unsigned int i = 0; i < _irows; i++) {
+            for (unsigned int j = 0; j < _icols; j++) {
+                y = (int)(ratio * i);
+                int index = y * _icols * _factor + j;
+                if (y == (int)_rows - 1)
+                    _interp[i * _icols + j] = _interp[index];
+                else {
+                    A = _interp[index];
+                    C = _interp[index + _icols * _factor];
+                    float y_diff = (ratio * i) - y;
+                    _interp[i * _icols + j] = (int16_t)(A + (C - A) * y_diff);
+                }
+            }
+        }
+    }
+
+    void zeroBelow(const int threshold)
+    {
+        for (unsigned int i = 0; i < _icols*_irows; i++) {
+            if (_interp[i] < threshold) _interp[i] = 0;
+        }
+    }
+
+    const unsigned int _cols, _rows, _size, _factor, _icols, _irows;
+    bool _reset_flag = true;
+
+    std::vector<int16_t> _nwin0, _nwin1, _nwin2;
+    std::vector<float> _fg, _bg;
+    std::vector<int16_t> _pixels;
+    std::vector<int16_t> _interp;
+    gesture_lib::DynamicGestureResult _result;
+};
+
+#endif // __GESTURE_REFERENCE_H__
@@ -0,0 +1,281 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Synthetic 10x6 sensor frames for the host tools
+*
+* makeSyntheticFrames() is the fixed sequence the benchmarks and tools have always used.
+* synthetic_scene renders configurable scenes instead: hand-sized Gaussian blobs swiping across the
+* array or hovering over it, over an ambient level that drifts, with per column gain mismatch, shot
+* and read noise and ADC saturation. Each frame comes with its ground truth: the blob centre and the
+* gesture label, for measuring centroid error and detection and event latency (gesture_bench).
+*/
+
+#ifndef __SYNTHETIC_FRAMES_H__
+#define __SYNTHETIC_FRAMES_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#define BENCH_SENSOR_COLS           (10u)
+#define BENCH_SENSOR_ROWS           (6u)
+#define BENCH_SENSOR_PIXELS         (BENCH_SENSOR_COLS * BENCH_SENSOR_ROWS)
+
+/*
+* Deterministic stand-in for sensor data: a Gaussian blob swiping across the array over a
+* noisy ambient offset, separated by idle periods, so both the active and inactive paths run
+*/
+inline void makeSyntheticFrames(std::vector<int16_t> &frames, unsigned int nframes)
+{
+    const unsigned int SWIPE_FRAMES = 40;
+    const unsigned int IDLE_FRAMES = 24;
+    uint32_t lcg = 12345u;
+
+    frames.resize(nframes * BENCH_SENSOR_PIXELS);
+    for (unsigned int f = 0; f < nframes; f++) {
+        unsigned int phase = f % (SWIPE_FRAMES + IDLE_FRAMES);
+        bool active = phase < SWIPE_FRAMES;
+        float t = (float)phase / (float)SWIPE_FRAMES;
+        float bx = -1.0f + t * (BENCH_SENSOR_COLS + 1);
+        float by = 1.0f + 3.0f * t;
+        for (unsigned int y = 0; y < BENCH_SENSOR_ROWS; y++) {
+            for (unsigned int x = 0; x < BENCH_SENSOR_COLS; x++) {
+                lcg = lcg * 1664525u + 1013904223u;
+                float noise = (float)((int)(lcg >> 24) - 128) * 0.25f;
+                float value = 200.0f + noise;
+                if (active) {
+                    float dx = (float)x - bx;
+                    float dy = (float)y - by;
+                    value += 6000.0f * expf(-(dx*dx + dy*dy) / 3.0f);
+                }
+                frames[f * BENCH_SENSOR_PIXELS + y * BENCH_SENSOR_COLS + x] = (int16_t)value;
+            }
+        }
+    }
+}
+
+// Gesture labels, the values of gesture_lib_types::GestureEvent
+typedef enum {
+    SYNTHETIC_NONE,
+    SYNTHETIC_SWIPE_LEFT,           // Towards lower x (cmx decreasing)
+    SYNTHETIC_SWIPE_RIGHT,
+    SYNTHETIC_SWIPE_UP,             // Towards lower y (cmy decreasing)
+    SYNTHETIC_SWIPE_DOWN,
+    SYNTHETIC_HOVER,                // Comes into view, stays in place, leaves: a click
+    SYNTHETIC_NUM_LABELS
+} synthetic_label;
+
+#define SYNTHETIC_ALL_GESTURES      (0x3Eu)     // Bit per synthetic_label
+
+typedef struct {
+    uint32_t seed;
+    uint32_t gestures;              // Bit per synthetic_label to draw the gestures from
+    float peak;                     // Blob amplitude, counts
+    float sigma;                    // Blob radius (standard deviation), pixels
+    float speed;                    // Swipe speed, pixels per frame
+    float path_jitter;              // Random offset of each path across its direction, pixels
+    unsigned int hover_frames;      // Frames a hover stays in place
+    unsigned int idle_frames;       // Empty frames between gestures
+    float ambient;                  // Ambient level, counts
+    float drift_amplitude;          // Slow sinusoidal ambient drift, counts
+    float drift_period;             // Frames
+    float gain_mismatch;            // Standard deviation of the column gains around 1
+    float shot_noise;               // Noise standard deviation per sqrt(count) of signal
+    float read_noise;               // Noise standard deviation, counts
+    int16_t saturation;             // Largest ADC value
+} synthetic_scene_config;
+
+inline synthetic_scene_config syntheticSceneDefaults()
+{
+    synthetic_scene_config c;
+    c.seed = 1;
+    c.gestures = SYNTHETIC_ALL_GESTURES;
+    c.peak = 6000.0f;
+    c.sigma = 1.2f;
+    c.speed = 0.3f;
+    c.path_jitter = 0.5f;
+    c.hover_frames = 20;
+    c.idle_frames = 24;
+    c.ambient = 200.0f;
+    c.drift_amplitude = 60.0f;
+    c.drift_period = 5000.0f;
+    c.gain_mismatch = 0.05f;
+    c.shot_noise = 0.5f;
+    c.read_noise = 8.0f;
+    c.saturation = 16383;
+    return c;
+}
+
+// Ground truth of one frame
+typedef struct {
+    uint8_t label;                  // synthetic_label of the gesture in view, SYNTHETIC_NONE between gestures
+    bool present;                   // The blob adds at least a tenth of its peak to some pixel
+    bool inside;                    // The blob centre lies over the array
+    float x, y;                     // Blob centre in sensor pixels (column, row); cmy is y * DY_PIXEL_SCALE
+    uint32_t gesture;               // Number of the gesture in view, from 1 (0 before the first)
+} synthetic_truth;
+
+class synthetic_scene
+{
+public:
+    synthetic_scene(const synthetic_scene_config &config = syntheticSceneDefaults()): _config(config), _lcg(config.seed)
+    {
+        for (unsigned int x = 0; x < BENCH_SENSOR_COLS; x++) _gain[x] = 1.0f + _config.gain_mismatch * gaussian();
+    }
+
+    const synthetic_scene_config &config() const { return _config; }
+    float columnGain(const unsigned int x) const { return _gain[x]; }
+
+    // Renders the next frame into pixels[BENCH_SENSOR_PIXELS]
+    void render(int16_t *pixels, synthetic_truth &truth)
+    {
+        if (_remaining == 0) nextSegment();
+        _remaining--;
+
+        truth.label = _idle ? SYNTHETIC_NONE : _label;
+        truth.gesture = _gesture;
+        truth.x = _x;
+        truth.y = _y;
+        truth.inside = !_idle && _x >= 0 && _x <= BENCH_SENSOR_COLS - 1 && _y >= 0 && _y <= BENCH_SENSOR_ROWS - 1;
+
+        const float ambient = _config.ambient + _config.drift_amplitude * sinf(6.2831853f * (float)_frame / _config.drift_period);
+        const float k = -0.5f / (_config.sigma * _config.sigma);
+        float max_signal = 0.0f;
+        for (unsigned int y = 0; y < BENCH_SENSOR_ROWS; y++) {
+            for (unsigned int x = 0; x < BENCH_SENSOR_COLS; x++) {
+                float signal = 0.0f;
+                if (!_idle) {
+                    const float dx = (float)x - _x, dy = (float)y - _y;
+                    signal = _config.peak * expf(k * (dx*dx + dy*dy));
+                    max_signal = std::max(max_signal, signal);
+                }
+                const float clean = ambient + signal;
+                float value = _gain[x] * clean + (_config.shot_noise * sqrtf(std::max(clean, 0.0f)) + _config.read_noise) * gaussian();
+                value = std::min(std::max(value, -32768.0f), (float)_config.saturation);
+                pixels[y * BENCH_SENSOR_COLS + x] = (int16_t)value;
+            }
+        }
+        truth.present = max_signal >= 0.1f * _config.peak;
+
+        _x += _vx;
+        _y += _vy;
+        _frame++;
+    }
+
+    void generate(std::vector<int16_t> &frames, std::vector<synthetic_truth> &truth, const unsigned int nframes)
+    {
+        frames.resize(nframes * BENCH_SENSOR_PIXELS);
+        truth.resize(nframes);
+        for (unsigned int f = 0; f < nframes; f++) render(&frames[f * BENCH_SENSOR_PIXELS], truth[f]);
+    }
+
+private:
+    // Starts the next gesture, or the idle gap after one
+    void nextSegment()
+    {
+        if (!_idle) {
+            _idle = true;
+            _remaining = std::max(_config.idle_frames, 1u);
+            _vx = _vy = 0.0f;
+            return;
+        }
+
+        _idle = false;
+        _gesture++;
+        const uint32_t enabled = _config.gestures & SYNTHETIC_ALL_GESTURES;
+        do {
+            _label = (uint8_t)(1 + next() % (SYNTHETIC_NUM_LABELS - 1));
+        } while (enabled != 0 && !(enabled & (1u << _label)));
+
+        // Swipes run from 2 sigma outside the array to 2 sigma outside the other side
+        const float margin = 2.0f * _config.sigma;
+        const float cx = (BENCH_SENSOR_COLS - 1) * 0.5f, cy = (BENCH_SENSOR_ROWS - 1) * 0.5f;
+        const float jitter = _config.path_jitter * (2.0f * uniform() - 1.0f);
+        const float speed = std::max(_config.speed, 0.01f);
+        float travel;
+        switch (_label) {
+        case SYNTHETIC_SWIPE_LEFT:
+        case SYNTHETIC_SWIPE_RIGHT:
+            travel = BENCH_SENSOR_COLS - 1 + 2.0f * margin;
+            _vx = _label == SYNTHETIC_SWIPE_RIGHT ? speed : -speed;
+            _vy = 0.0f;
+            _x = _label == SYNTHETIC_SWIPE_RIGHT ? -margin : BENCH_SENSOR_COLS - 1 + margin;
+            _y = cy + jitter;
+            _remaining = (unsigned int)(travel / speed) + 1;
+            break;
+        case SYNTHETIC_SWIPE_UP:
+        case SYNTHETIC_SWIPE_DOWN:
+            travel = BENCH_SENSOR_ROWS - 1 + 2.0f * margin;
+            _vx = 0.0f;
+            _vy = _label == SYNTHETIC_SWIPE_DOWN ? speed : -speed;
+            _x = cx + jitter;
+            _y = _label == SYNTHETIC_SWIPE_DOWN ? -margin : BENCH_SENSOR_ROWS - 1 + margin;
+            _remaining = (unsigned int)(travel / speed) + 1;
+            break;
+        default:
+            _vx = _vy = 0.0f;
+            _x = cx + jitter;
+            _y = cy + 0.5f * jitter;
+            _remaining = std::max(_config.hover_frames, 1u);
+            break;
+        }
+    }
+
+    uint32_t next()
+    {
+        _lcg = _lcg * 1664525u + 1013904223u;
+        return _lcg >> 8;
+    }
+
+    float uniform() { return (float)next() * (1.0f / 16777216.0f); }
+
+    // Approximately normal, unit variance: sum of four uniforms
+    float gaussian() { return (uniform() + uniform() + uniform() + uniform() - 2.0f) * 1.7320508f; }
+
+    const synthetic_scene_config _config;
+    uint32_t _lcg;
+    float _gain[BENCH_SENSOR_COLS];
+
+    uint32_t _frame = 0;
+    uint32_t _gesture = 0;
+    uint8_t _label = SYNTHETIC_NONE;
+    bool _idle = false;             // The scene starts with a gap
+    unsigned int _remaining = 0;
+    float _x = 0, _y = 0, _vx = 0, _vy = 0;
+};
+
+#endif // __SYNTHETIC_FRAMES_H__
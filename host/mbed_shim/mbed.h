@@ -0,0 +1,313 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Minimal Mbed OS 6 stand-in for building the MAX25x05 driver and gesture_lib on a host (Linux) machine.
+*
+* Only the parts of the Mbed API used by this repository are provided. Digital pins and buses are
+* inert: writes are discarded and reads return zero. This is enough to compile the libraries and to
+* exercise gesture_lib with recorded or synthetic frames without a MAX32620FTHR attached.
+*/
+
+#ifndef __MBED_HOST_SHIM_H__
+#define __MBED_HOST_SHIM_H__
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#define MBED_HOST_SHIM              1
+
+#define MBED_ASSERT(expr)           assert(expr)
+
+#define DEVICE_SPI_ASYNCH           1
+
+#define SPI_EVENT_ERROR             (1 << 1)
+#define SPI_EVENT_COMPLETE          (1 << 2)
+#define SPI_EVENT_RX_OVERFLOW       (1 << 3)
+#define SPI_EVENT_ALL               (SPI_EVENT_ERROR | SPI_EVENT_COMPLETE | SPI_EVENT_RX_OVERFLOW)
+
+#define DEVICE_I2C_ASYNCH           1
+
+#define I2C_EVENT_ERROR                 (1 << 1)
+#define I2C_EVENT_ERROR_NO_SLAVE        (1 << 2)
+#define I2C_EVENT_TRANSFER_COMPLETE     (1 << 3)
+#define I2C_EVENT_TRANSFER_EARLY_NACK   (1 << 4)
+#define I2C_EVENT_ALL                   (I2C_EVENT_ERROR | I2C_EVENT_TRANSFER_COMPLETE | I2C_EVENT_ERROR_NO_SLAVE | I2C_EVENT_TRANSFER_EARLY_NACK)
+
+typedef enum {
+    DMA_USAGE_NEVER,
+    DMA_USAGE_OPPORTUNISTIC,
+    DMA_USAGE_ALWAYS,
+    DMA_USAGE_TEMPORARY_ALLOCATED,
+    DMA_USAGE_ALLOCATED
+} DMAUsage;
+
+typedef enum {
+    P3_2, P3_3, P3_4, P3_5,
+    P5_0, P5_1, P5_2, P5_3, P5_4, P5_5,
+    LED1, LED2, LED3,
+    NC = -1
+} PinName;
+
+// Microsecond ticker and busy wait on the host steady clock
+inline uint32_t us_ticker_read()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline void wait_us(int us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+// mbed_critical.h subset: the handlers run by InterruptIn::simulate_fall/rise count as interrupt context
+inline volatile bool &mbed_shim_isr_active()
+{
+    static volatile bool active = false;
+    return active;
+}
+
+inline bool core_util_is_isr_active(void)
+{
+    return mbed_shim_isr_active();
+}
+
+// The host runs the driver on one thread and simulated interrupts run synchronously, so a critical
+// section has nothing to hold off
+inline void core_util_critical_section_enter(void) {}
+inline void core_util_critical_section_exit(void) {}
+
+// mbed_atomic.h subset
+inline void core_util_atomic_store_u32(volatile uint32_t *ptr, uint32_t value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+inline uint32_t core_util_atomic_fetch_or_u32(volatile uint32_t *ptr, uint32_t arg)
+{
+    return __atomic_fetch_or(ptr, arg, __ATOMIC_SEQ_CST);
+}
+
+inline uint32_t core_util_atomic_fetch_and_u32(volatile uint32_t *ptr, uint32_t arg)
+{
+    return __atomic_fetch_and(ptr, arg, __ATOMIC_SEQ_CST);
+}
+
+namespace mbed {
+
+template <typename F>
+class Callback;
+
+// Thin wrapper over std::function with the Mbed Callback call semantics used in this repository
+template <typename R, typename... Args>
+class Callback<R(Args...)> {
+public:
+    Callback() {}
+    Callback(R (*func)(Args...)) { if (func) _func = func; }
+    template <typename T>
+    Callback(T *obj, R (T::*method)(Args...)):
+        _func([obj, method](Args... args) { return (obj->*method)(args...); }) {}
+
+    R call(Args... args) const { return _func(args...); }
+    R operator()(Args... args) const { return _func(args...); }
+    explicit operator bool() const { return static_cast<bool>(_func); }
+
+private:
+    std::function<R(Args...)> _func;
+};
+
+typedef Callback<void(int)> event_callback_t;
+
+template <typename T, typename R, typename... Args>
+Callback<R(Args...)> callback(T *obj, R (T::*method)(Args...))
+{
+    return Callback<R(Args...)>(obj, method);
+}
+
+template <typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(Args...))
+{
+    return Callback<R(Args...)>(func);
+}
+
+// drivers/Timer.h subset on the host steady clock
+class Timer {
+public:
+    void start() { if (!_running) { _started = std::chrono::steady_clock::now(); _running = true; } }
+    void stop() { _elapsed = elapsed_time(); _running = false; }
+    void reset() { _elapsed = std::chrono::microseconds(0); _started = std::chrono::steady_clock::now(); }
+    std::chrono::microseconds elapsed_time() const
+    {
+        using namespace std::chrono;
+        if (!_running) return _elapsed;
+        return _elapsed + duration_cast<microseconds>(steady_clock::now() - _started);
+    }
+
+private:
+    std::chrono::steady_clock::time_point _started;
+    std::chrono::microseconds _elapsed{0};
+    bool _running = false;
+};
+
+class DigitalOut {
+public:
+    DigitalOut(PinName pin, int value = 0): _pin(pin), _value(value) {}
+
+    void write(int value) { _value = value; }
+    int read() { return _value; }
+    DigitalOut &operator=(int value) { write(value); return *this; }
+    operator int() { return read(); }
+
+private:
+    PinName _pin;
+    int _value;
+};
+
+class InterruptIn {
+public:
+    InterruptIn(PinName pin): _pin(pin) { if (pin != NC) attached(pin) = this; }
+    ~InterruptIn() { if (_pin != NC && attached(_pin) == this) attached(_pin) = NULL; }
+
+    void fall(Callback<void()> func) { _fall = func; }
+    void rise(Callback<void()> func) { _rise = func; }
+    int read() { return 1; }
+
+    // Host only: invoke the attached handlers as if the pin had changed state
+    void simulate_fall() { simulate(_fall); }
+    void simulate_rise() { simulate(_rise); }
+
+    // Host only: the InterruptIn of pin, e.g. to raise the INTB edge of a driver that owns its pin
+    static InterruptIn *on_pin(PinName pin) { return pin != NC ? attached(pin) : NULL; }
+
+private:
+    static void simulate(Callback<void()> &handler)
+    {
+        if (!handler) return;
+        mbed_shim_isr_active() = true;
+        handler();
+        mbed_shim_isr_active() = false;
+    }
+
+    static InterruptIn *&attached(PinName pin)
+    {
+        static InterruptIn *pins[32] = {};
+        assert((int)pin >= 0 && (int)pin < 32);
+        return pins[pin];
+    }
+
+    PinName _pin;
+    Callback<void()> _fall;
+    Callback<void()> _rise;
+};
+
+class SPI {
+public:
+    SPI(PinName mosi, PinName miso, PinName sclk, PinName ssel = NC) {}
+
+    void frequency(int hz = 1000000) { _hz = hz; }
+    void format(int bits, int mode = 0) {}
+    void set_default_write_value(char data) {}
+    int set_dma_usage(DMAUsage usage) { return 0; }
+    int write(int value) { return 0; }
+    int write(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length)
+    {
+        if (rx_buffer) memset(rx_buffer, 0, rx_length);
+        return tx_length > rx_length ? tx_length : rx_length;
+    }
+
+    // Completes immediately: the callback runs before transfer() returns
+    int transfer(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length,
+                 const event_callback_t &callback, int event = SPI_EVENT_COMPLETE)
+    {
+        write(tx_buffer, tx_length, rx_buffer, rx_length);
+        if (callback && (event & SPI_EVENT_COMPLETE)) callback(SPI_EVENT_COMPLETE);
+        return 0;
+    }
+
+private:
+    int _hz = 1000000;
+};
+
+class I2C {
+public:
+    I2C(PinName sda, PinName scl) {}
+
+    void frequency(int hz) { _hz = hz; }
+    int write(int address, const char *data, int length, bool repeated = false) { return 0; }
+    int read(int address, char *data, int length, bool repeated = false)
+    {
+        memset(data, 0, length);
+        return 0;
+    }
+    void stop() {}
+
+    // Write then read after a repeated start; completes immediately, the callback runs before transfer() returns
+    int transfer(int address, const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length,
+                 const event_callback_t &callback, int event = I2C_EVENT_TRANSFER_COMPLETE, bool repeated = false)
+    {
+        if (tx_length > 0) write(address, tx_buffer, tx_length, true);
+        if (rx_length > 0) read(address, rx_buffer, rx_length, repeated);
+        if (callback && (event & I2C_EVENT_TRANSFER_COMPLETE)) callback(I2C_EVENT_TRANSFER_COMPLETE);
+        return 0;
+    }
+
+private:
+    int _hz = 100000;
+};
+
+} // namespace mbed
+
+// rtos/ThisThread.h subset: the host driver runs on one thread, sleeping blocks it
+namespace rtos {
+namespace ThisThread {
+inline void sleep_for(std::chrono::duration<uint32_t, std::milli> rel_time)
+{
+    std::this_thread::sleep_for(rel_time);
+}
+} // namespace ThisThread
+} // namespace rtos
+
+using namespace mbed;
+using namespace rtos;
+
+#endif // __MBED_HOST_SHIM_H__
@@ -0,0 +1,225 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Replays a raw frame recording (frame_recording.h) through gesture_lib as fast as possible
+*
+* The recording is memory mapped and every frame is copied into gesture_lib::pixels and processed
+* with processGesture(), so a capture of hours runs in seconds. Prints the recording metadata, the
+* number of active frames and gestures, the gesture events by type and the replay speed against the
+* recorded time, and how often the adaptive frame rate (MAX25x05AdaptiveRate) would have switched
+* profile and run the idle one. --csv prints the DynamicGestureResult of every frame instead, for tuning thresholds offline.
+*
+* --synthetic writes a recording of synthetic frames with the driver's default register settings,
+* to try the tools without a sensor attached.
+*
+* Usage: frame_replay <recording> [--fast] [--repeat n] [--csv]
+*        frame_replay --synthetic <recording> [frames]
+*/
+
+#include "MAX25x05.h"
+#include "MAX25x05AdaptiveRate.h"
+#include "gesture_lib.h"
+#include "frame_recording.h"
+#include "synthetic_frames.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Sensor the synthetic frames stand in for, stored in the recordings --synthetic writes
+#define REPLAY_SYNTHETIC_DEVICE     MAX25X05_DEVICE_MAX25405
+
+static int writeSynthetic(const char *path, const unsigned int nframes)
+{
+    MAX25x05_RegisterSetting registers[FRAME_RECORDING_MAX_REGISTERS];
+    size_t num_registers = MAX25x05::default_register_settings(REPLAY_SYNTHETIC_DEVICE, registers, FRAME_RECORDING_MAX_REGISTERS);
+    uint8_t register_pairs[FRAME_RECORDING_MAX_REGISTERS][2];
+    for (size_t i = 0; i < num_registers; i++) {
+        register_pairs[i][0] = registers[i].reg;
+        register_pairs[i][1] = registers[i].value;
+    }
+
+    frame_recording_header header;
+    frame_recording_init_header(header, REPLAY_SYNTHETIC_DEVICE, BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS, register_pairs,
+                                (uint8_t)num_registers, (uint64_t)time(NULL));
+
+    std::vector<int16_t> frames;
+    makeSyntheticFrames(frames, nframes);
+
+    frame_recording_writer recording;
+    if (!recording.open(path, header)) {
+        fprintf(stderr, "%s: cannot create, or holds a recording with other settings\n", path);
+        return 1;
+    }
+    for (unsigned int f = 0; f < nframes; f++) {
+        // 100 frames/s
+        if (!recording.append(f, f * 10000u, &frames[f * BENCH_SENSOR_PIXELS])) {
+            fprintf(stderr, "%s: write failed\n", path);
+            return 1;
+        }
+    }
+    printf("%s: %u frames\n", path, recording.frames());
+    return 0;
+}
+
+static void printHeader(const char *path, const frame_recording_view &recording)
+{
+    const frame_recording_header &header = recording.header();
+    const char *device = header.device_type == MAX25X05_DEVICE_MAX25405 ? "MAX25405" :
+                         header.device_type == MAX25X05_DEVICE_MAX25205 ? "MAX25205" : "unknown device";
+    time_t start = (time_t)header.start_time;
+
+    printf("%s: %s, %ux%u pixels, %u frames, recorded %s", path, device, header.cols, header.rows,
+           (unsigned int)recording.frames(), header.start_time ? ctime(&start) : "(no date)\n");
+    printf("registers:");
+    for (uint8_t i = 0; i < header.num_registers; i++) printf(" %02X=%02X", header.registers[i][0], header.registers[i][1]);
+    printf("\n");
+}
+
+static int replay(const frame_recording_view &recording, const gesture_lib::GestureType type, const unsigned int repeats, const bool csv)
+{
+    static gesture_lib g(BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+    const size_t nframes = recording.frames();
+
+    static const char *event_names[] = {"none", "left", "right", "up", "down", "click"};
+    const unsigned int num_events = sizeof(event_names) / sizeof(event_names[0]);
+    unsigned int active = 0, gestures = 0;
+    unsigned int events[num_events] = {0};
+    double confidence[num_events] = {0};
+    MAX25x05AdaptiveRate rate(START_DETECTION_THRESHOLD, END_DETECTION_THRESHOLD, (MAX25x05_DeviceType)recording.header().device_type);
+    bench_clock::time_point t0 = bench_clock::now();
+    for (unsigned int r = 0; r < repeats; r++) {
+        g.resetGesture();
+        rate.reset();
+        gesture_lib::GestureState last_state = gesture_lib::STATE_INACTIVE;
+        for (size_t f = 0; f < nframes; f++) {
+            memcpy(g.pixels, recording.pixels(f), NUM_SENSOR_PIXELS * sizeof(int16_t));
+            g.processGesture(WINDOW_FILTER_ALPHA, type);
+
+            const gesture_lib::DynamicGestureResult &result = g.dynamicResult;
+            if (result.state == gesture_lib::GESTURE_IN_PROGRESS) {
+                active++;
+                if (last_state == gesture_lib::STATE_INACTIVE) gestures++;
+            }
+            else if (last_state == gesture_lib::GESTURE_IN_PROGRESS && result.event < num_events) {
+                events[result.event]++;
+                confidence[result.event] += result.event_confidence;
+            }
+            last_state = (gesture_lib::GestureState)result.state;
+            rate.update(result.maxpixel);
+
+            if (csv) {
+                printf("%u,%u,%u,%d,%.3f,%.3f,%d,%u,%.2f\n", recording.sequence(f), recording.timestamp_us(f), result.state,
+                       result.maxpixel, result.cmx, result.cmy, (int)result.CoM_Intensity, result.event, result.event_confidence);
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(bench_clock::now() - t0).count();
+
+    if (!csv && nframes > 0) {
+        double recorded_s = (double)(uint32_t)(recording.timestamp_us(nframes - 1) - recording.timestamp_us(0)) * 1e-6;
+        double total = (double)nframes * repeats;
+        printf("%u active frames, %u gestures per pass\n", active / repeats, gestures / repeats);
+        printf("events:");
+        for (unsigned int e = 0; e < num_events; e++) {
+            printf(" %s %u (%.2f)", event_names[e], events[e] / repeats, events[e] ? confidence[e] / events[e] : 0.0);
+        }
+        printf("\n");
+        printf("adaptive rate: %u profile switches, %.1f%% of frames idle (the recording ran one profile throughout)\n",
+               rate.switches() / repeats, 100.0 * rate.idle_frames() / total);
+        printf("replayed %.0f frames in %.3f s: %.1f ns/frame, %.0f frames/s, %.0fx recorded time\n", total, seconds,
+               seconds * 1e9 / total, total / seconds, seconds > 0 ? recorded_s * repeats / seconds : 0.0);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2 && strcmp(argv[1], "--synthetic") == 0) {
+        unsigned int nframes = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 0) : 100000;
+        return writeSynthetic(argv[2], nframes > 0 ? nframes : 100000);
+    }
+
+    if (argc < 2) {
+        printf("usage: %s <recording> [--fast] [--repeat n] [--csv]\n       %s --synthetic <recording> [frames]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    gesture_lib::GestureType type = gesture_lib::GEST_DYNAMIC;
+    unsigned int repeats = 1;
+    bool csv = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) type = gesture_lib::GEST_DYNAMIC_FAST;
+        else if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeats = (unsigned int)strtoul(argv[++i], NULL, 0);
+    }
+    if (repeats == 0) repeats = 1;
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    void *data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map\n", argv[1]);
+        return 1;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    frame_recording_view recording;
+    int result = 1;
+    if (!recording.attach(data, st.st_size)) {
+        fprintf(stderr, "%s: not a frame recording\n", argv[1]);
+    }
+    else if (recording.header().cols != BENCH_SENSOR_COLS || recording.header().rows != BENCH_SENSOR_ROWS) {
+        fprintf(stderr, "%s: %ux%u frames, gesture_lib replay is built for %ux%u\n", argv[1], recording.header().cols,
+                recording.header().rows, BENCH_SENSOR_COLS, BENCH_SENSOR_ROWS);
+    }
+    else {
+        if (!csv) printHeader(argv[1], recording);
+        result = replay(recording, type, repeats, csv);
+    }
+
+    munmap(data, st.st_size);
+    return result;
+}
@@ -0,0 +1,213 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Host decoder for the binary frame stream (frame_stream.h)
+*
+* Reads the stream from a file or serial device (configure the port first, e.g. stty -F /dev/ttyACM0 raw 921600)
+* and prints one CSV line per frame: sequence, timestamp_us and the pixels. A summary of decoded frames, CRC
+* errors and lost packets goes to stderr at the end. With --record the frames are appended to a recording
+* (frame_recording.h) instead; it starts at the first info packet, which carries the register settings.
+* Profile packets of a firmware built with GESTURE_PROFILE are printed to stderr as they arrive.
+*
+* With --bench, encodes synthetic frames raw and with delta encoding instead, checks that they decode to the
+* same pixels and reports bytes per frame, encode/decode time and the frame rate a serial link can carry.
+*
+* Usage: frame_stream_decode <file|-> [--quiet | --record <recording>]
+*        frame_stream_decode --bench [frames]
+*/
+
+#include "frame_stream.h"
+#include "frame_recording.h"
+#include "synthetic_frames.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+// One line per stage: count, min/avg/max in us and the non-empty histogram buckets as <upper bound in us>:count
+static void printProfile(const frame_stream_profile &profile)
+{
+    const double us_per_tick = profile.ticks_per_us > 0 ? 1.0 / profile.ticks_per_us : 1.0;
+    fprintf(stderr, "profile %-16s %10u %10.2f %10.2f %10.2f ", profile.name, profile.count, profile.min * us_per_tick,
+            profile.avg * us_per_tick, profile.max * us_per_tick);
+    for (uint8_t b = 0; b < profile.num_buckets; b++) {
+        if (profile.buckets[b] == 0) continue;
+        if (b == profile.num_buckets - 1) fprintf(stderr, " more:%u", profile.buckets[b]);
+        else fprintf(stderr, " %.2f:%u", (double)(1u << b) * us_per_tick, profile.buckets[b]);
+    }
+    fprintf(stderr, "\n");
+}
+
+static int decodeStream(FILE *in, const bool quiet, const char *record_path)
+{
+    static uint8_t buf[4096];
+    frame_stream_decoder decoder;
+    frame_recording_writer recording;
+    bool recording_open = false;
+    unsigned int skipped = 0;
+
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            frame_stream_decoder::Status status = decoder.push(buf[i]);
+
+            if (status == frame_stream_decoder::FRAME_INFO && record_path != NULL && !recording_open) {
+                const frame_stream_info &info = decoder.info();
+                frame_recording_header header;
+                frame_recording_init_header(header, info.device_type, info.cols, info.rows, info.registers, info.num_registers,
+                                            (uint64_t)time(NULL));
+                if (!recording.open(record_path, header)) {
+                    fprintf(stderr, "%s: cannot create, or holds a recording with other settings\n", record_path);
+                    return 1;
+                }
+                recording_open = true;
+            }
+            if (status == frame_stream_decoder::FRAME_PROFILE) printProfile(decoder.profile());
+            if (status != frame_stream_decoder::FRAME_OK) continue;
+
+            const frame_stream_frame &frame = decoder.frame();
+            if (record_path != NULL) {
+                if (!recording_open || frame.num_pixels != decoder.info().cols * decoder.info().rows) skipped++;
+                else if (!recording.append(frame.sequence, frame.timestamp_us, frame.pixels)) {
+                    fprintf(stderr, "%s: write failed\n", record_path);
+                    return 1;
+                }
+            }
+            else if (!quiet) {
+                printf("%u,%u", frame.sequence, frame.timestamp_us);
+                for (uint8_t p = 0; p < frame.num_pixels; p++) printf(",%d", frame.pixels[p]);
+                printf("\n");
+            }
+        }
+    }
+
+    fprintf(stderr, "%u frames, %u CRC errors, %u format errors, %u lost packets\n", decoder.frames_decoded(),
+            decoder.crc_errors(), decoder.format_errors(), decoder.lost_packets());
+    if (record_path != NULL) {
+        fprintf(stderr, "%s: %u frames recorded, %u skipped (before the first info packet or of another size)\n", record_path, recording.frames(), skipped);
+    }
+    return 0;
+}
+
+// Length of the line the firmware used to print for the Processing viewer ("p0,p1,...,p59,\r\n")
+static size_t csvLineBytes(const int16_t pixels[])
+{
+    char text[16];
+    size_t bytes = 2;
+    for (unsigned int i = 0; i < BENCH_SENSOR_PIXELS; i++) bytes += snprintf(text, sizeof(text), "%d,", pixels[i]);
+    return bytes;
+}
+
+static bool benchEncoding(const std::vector<int16_t> &frames, const unsigned int nframes, const bool delta, const double csv_bytes)
+{
+    std::vector<uint8_t> stream;
+    stream.reserve(nframes * FRAME_STREAM_MAX_ENCODED_BYTES(BENCH_SENSOR_PIXELS));
+    uint8_t packet[FRAME_STREAM_MAX_ENCODED_BYTES(BENCH_SENSOR_PIXELS)];
+
+    frame_stream_encoder encoder(delta);
+    bench_clock::time_point t0 = bench_clock::now();
+    for (unsigned int f = 0; f < nframes; f++) {
+        size_t n = encoder.encode(f, f * 10000u, &frames[f * BENCH_SENSOR_PIXELS], BENCH_SENSOR_PIXELS, packet);
+        stream.insert(stream.end(), packet, packet + n);
+    }
+    double encode_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count() / nframes;
+
+    frame_stream_decoder decoder;
+    unsigned int mismatches = 0;
+    unsigned int next = 0;
+    t0 = bench_clock::now();
+    decoder.feed(stream.data(), stream.size(), [&](const frame_stream_frame &frame) {
+        if (frame.sequence != next || frame.num_pixels != BENCH_SENSOR_PIXELS ||
+            memcmp(frame.pixels, &frames[next * BENCH_SENSOR_PIXELS], BENCH_SENSOR_PIXELS * sizeof(int16_t)) != 0) {
+            mismatches++;
+        }
+        next++;
+    });
+    double decode_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count() / nframes;
+
+    double bytes = (double)stream.size() / nframes;
+    printf("%-8s %10.1f %9.1f%% %10.1f %10.1f %12.0f %12.0f   %u/%u frames ok\n", delta ? "delta" : "raw", bytes,
+           100.0 * bytes / csv_bytes, encode_ns, decode_ns, 115200.0 / 10.0 / bytes, 921600.0 / 10.0 / bytes,
+           next - mismatches, nframes);
+    return mismatches == 0 && next == nframes;
+}
+
+static int bench(const unsigned int nframes)
+{
+    std::vector<int16_t> frames;
+    makeSyntheticFrames(frames, nframes);
+
+    double csv_bytes = 0;
+    for (unsigned int f = 0; f < nframes; f++) csv_bytes += csvLineBytes(&frames[f * BENCH_SENSOR_PIXELS]);
+    csv_bytes /= nframes;
+
+    printf("frame stream: %u synthetic 10x6 frames, CSV text %.1f bytes/frame (%.0f frames/s at 115200 baud)\n",
+           nframes, csv_bytes, 115200.0 / 10.0 / csv_bytes);
+    printf("%-8s %10s %10s %10s %10s %12s %12s\n", "encoding", "bytes", "vs CSV", "enc ns", "dec ns", "fps@115200", "fps@921600");
+
+    bool ok = benchEncoding(frames, nframes, false, csv_bytes);
+    ok = benchEncoding(frames, nframes, true, csv_bytes) && ok;
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        unsigned int nframes = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 0) : 4096;
+        return bench(nframes > 0 ? nframes : 4096);
+    }
+
+    if (argc < 2) {
+        printf("usage: %s <file|-> [--quiet | --record <recording>]\n       %s --bench [frames]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    const bool quiet = argc > 2 && strcmp(argv[2], "--quiet") == 0;
+    const char *record_path = argc > 3 && strcmp(argv[2], "--record") == 0 ? argv[3] : NULL;
+    int result = decodeStream(in, quiet, record_path);
+    if (in != stdin) fclose(in);
+    return result;
+}
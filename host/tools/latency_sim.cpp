@@ -0,0 +1,291 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Host simulation of the acquisition path with a mock bus and a fake clock, to validate latency_tracer
+*
+* A MAX25x05 driver reads synthetic frames from a mock bus, where every transfer advances the fake
+* clock by its SPI time. INTB is raised on the driver's pin once per frame period and the frames take
+* the path of the firmware's RTOS pipeline (main.cpp): read after a wake-up delay, processed with
+* gesture_lib in order once the processing thread is free, and passed to the mouse output stage
+* (mouse_output.h) as in main.cpp. A report it hands out waits for the next USB frame. Processing
+* takes a scripted time with a slow frame now and then, so some frames overrun the next conversion
+* and queue up.
+*
+* The simulation keeps its own account of every frame's latency and of the overruns and checks the
+* tracer's p50/p99/max and counts against it. The fake clock starts shortly before the 32 bit
+* microsecond ticker wraps. Exits with 1 on any difference.
+*
+* Usage: latency_sim [frames] [period_us]
+*/
+
+#include "MAX25x05.h"
+#include "gesture_lib.h"
+#include "latency_tracer.h"
+#include "mouse_output.h"
+#include "synthetic_frames.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#define SIM_INTB_PIN                P5_3
+#define SIM_SPI_HZ                  (6000000u)
+#define SIM_TRANSACTION_US          (5u)            // Chip select and setup per bus transaction
+#define SIM_QUEUE_DEPTH             (8u)            // As GESTURE_PIPELINE_QUEUE_DEPTH
+#define SIM_USB_FRAME_US            (1000u)         // Full speed HID: a report leaves on the next 1 ms frame
+#define SIM_CLOCK_EPOCH             (0xFFFFFFFFu - 250000u)
+
+// Fake clock: sim_time_us runs from 0, the tracer sees it offset by SIM_CLOCK_EPOCH modulo 2^32
+static uint64_t sim_time_us = 0;
+
+static uint32_t simClock()
+{
+    return (uint32_t)(SIM_CLOCK_EPOCH + sim_time_us);
+}
+
+/*
+* Bus of a sensor whose pixel registers hold the current synthetic frame. Every transfer takes its
+* SPI time on the fake clock.
+*/
+class mock_bus : public MAX25x05_BusInterface
+{
+public:
+    void begin(int hz) {}
+
+    int reg_write(const uint8_t reg_addr, const uint8_t reg_val)
+    {
+        transfer(3);
+        return 0;
+    }
+
+    int reg_read(const uint8_t reg_addr, const uint8_t num_bytes, uint8_t reg_vals[])
+    {
+        memset(reg_vals, 0, num_bytes);
+        if (num_bytes == NUM_SENSOR_PIXELS * 2 && frame != NULL) {
+            for (unsigned int i = 0; i < NUM_SENSOR_PIXELS; i++) {
+                reg_vals[2 * i] = (uint8_t)((uint16_t)frame[i] >> 8);
+                reg_vals[2 * i + 1] = (uint8_t)frame[i];
+            }
+        }
+        transfer(2 + num_bytes);
+        return 0;
+    }
+
+    const int16_t *frame = NULL;
+
+private:
+    static void transfer(const unsigned int bytes)
+    {
+        sim_time_us += SIM_TRANSACTION_US + (bytes * 8u * 1000000u + SIM_SPI_HZ - 1) / SIM_SPI_HZ;
+    }
+};
+
+typedef struct {
+    uint32_t sequence;
+    uint64_t interrupt_us, read_start_us, read_end_us;
+    int16_t pixels[NUM_SENSOR_PIXELS];
+} sim_frame;
+
+class latency_sim
+{
+public:
+    latency_sim(const unsigned int nframes, const uint32_t period_us):
+        _nframes(nframes), _period_us(period_us), _sensor(_bus, SIM_INTB_PIN, MAX25X05_DEVICE_MAX25405), _gesture(SENSOR_COLS, SENSOR_ROWS),
+        _tracer(simClock)
+    {
+        makeSyntheticFrames(_frames, nframes);
+    }
+
+    // Runs the simulation, returns the number of differences between the tracer and the simulation
+    unsigned int run()
+    {
+        _sensor.set_default_register_settings();
+        _sensor.attach_data_ready(callback(this, &latency_sim::intb_handler));
+        _sensor.enable_read_sensor_frames();
+        sim_time_us = 0;
+        _tracer.reset();
+
+        for (unsigned int k = 1; k <= _nframes; k++) {
+            const uint64_t interrupt_us = (uint64_t)k * _period_us;
+            processUntil(interrupt_us);
+
+            sim_time_us = interrupt_us;
+            _bus.frame = &_frames[(k - 1) * BENCH_SENSOR_PIXELS];
+            InterruptIn::on_pin(SIM_INTB_PIN)->simulate_fall();
+            acquire(interrupt_us);
+        }
+        processUntil(UINT64_MAX);
+
+        return check();
+    }
+
+private:
+    // The data ready callback, from MAX25x05::intb_handler: as gesture_pipeline::intb_handler
+    void intb_handler()
+    {
+        _sequence++;
+        _tracer.mark(_sequence, LATENCY_INTERRUPT);
+    }
+
+    // Wake-up latency of the acquisition thread, varies a little from frame to frame
+    static uint32_t wakeupUs(const uint32_t sequence) { return 30u + (sequence * 7u) % 40u; }
+
+    // Scripted processing time: every 97th frame is slower than the frame period
+    uint32_t processingUs(const uint32_t sequence) const
+    {
+        return 2500u + (sequence * 37u) % 1000u + (sequence % 97u == 0 ? _period_us + 3000u : 0);
+    }
+
+    void acquire(const uint64_t interrupt_us)
+    {
+        if (_queue.size() >= SIM_QUEUE_DEPTH) {
+            _dropped++;
+            return;
+        }
+        sim_frame f;
+        f.sequence = _sequence;
+        f.interrupt_us = interrupt_us;
+        f.read_start_us = interrupt_us + wakeupUs(_sequence);
+        sim_time_us = f.read_start_us;
+        _tracer.mark(f.sequence, LATENCY_READ_START);
+        _sensor.getSensorPixelInts(f.pixels, false);
+        _tracer.mark(f.sequence, LATENCY_READ_END);
+        f.read_end_us = sim_time_us;
+        _queue.push_back(f);
+    }
+
+    // Processes the queued frames whose processing ends by until_us
+    void processUntil(const uint64_t until_us)
+    {
+        while (!_queue.empty()) {
+            const sim_frame &f = _queue.front();
+            const uint64_t start_us = std::max(f.read_end_us, _busy_until_us);
+            const uint64_t end_us = start_us + processingUs(f.sequence);
+            if (end_us > until_us) return;
+
+            sim_time_us = start_us;
+            memcpy(_gesture.pixels, f.pixels, sizeof(f.pixels));
+            _gesture.processGesture(WINDOW_FILTER_ALPHA, _gesture.GEST_TRACKING);
+            sim_time_us = end_us;
+            _tracer.mark(f.sequence, LATENCY_PROCESS_END);
+            _busy_until_us = end_us;
+
+            // Overran if the next conversion ended first
+            if (end_us > (uint64_t)(f.sequence + 1) * _period_us) _overruns++;
+            _processed++;
+
+            _mouse.update(_gesture.trackingResult, _gesture.dynamicResult.CoM_Intensity);
+            int16_t x, y;
+            if (_mouse.poll(simClock(), x, y)) {
+                const uint64_t submit_us = end_us + SIM_USB_FRAME_US - end_us % SIM_USB_FRAME_US;
+                sim_time_us = submit_us;
+                _tracer.mark(f.sequence, LATENCY_HID_SUBMIT);
+                _busy_until_us = submit_us;
+
+                _expected[LATENCY_WAKEUP].push_back((uint32_t)(f.read_start_us - f.interrupt_us));
+                _expected[LATENCY_READOUT].push_back((uint32_t)(f.read_end_us - f.read_start_us));
+                _expected[LATENCY_PROCESSING].push_back((uint32_t)(end_us - f.read_end_us));
+                _expected[LATENCY_OUTPUT].push_back((uint32_t)(submit_us - end_us));
+                _expected[LATENCY_TOTAL].push_back((uint32_t)(submit_us - f.interrupt_us));
+            }
+
+            if (!_tracer.frame_done(f.sequence)) _incomplete++;
+            _queue.pop_front();
+        }
+    }
+
+    unsigned int check()
+    {
+        latency_summary s;
+        _tracer.summary(s);
+        _tracer.print();
+        printf("simulation: %u conversions every %u us, %u processed, %u dropped (queue full), %u overruns, %u reports\n",
+               _nframes, _period_us, _processed, _dropped, _overruns, (unsigned int)_expected[LATENCY_TOTAL].size());
+        printf("mouse output: %u frames moved the pointer, %u reports\n", _mouse.updates(), _mouse.reports());
+
+        unsigned int mismatches = _incomplete;
+        if (s.frames != _processed || s.overruns != _overruns || s.reports != _expected[LATENCY_TOTAL].size()) mismatches++;
+
+        const size_t n = _expected[LATENCY_TOTAL].size();
+        const size_t window = std::min(n, (size_t)LATENCY_TRACER_WINDOW);
+        if (s.window != window) mismatches++;
+        for (unsigned int k = 0; k < LATENCY_NUM_SEGMENTS && window > 0; k++) {
+            std::vector<uint32_t> last(_expected[k].end() - window, _expected[k].end());
+            std::sort(last.begin(), last.end());
+            const latency_percentiles &p = s.segments[k];
+            if (p.p50 != last[latency_tracer::percentile_index(window, 50)] ||
+                p.p99 != last[latency_tracer::percentile_index(window, 99)] || p.max != last[window - 1]) {
+                printf("%s: tracer p50/p99/max %u/%u/%u us, simulation %u/%u/%u us\n", latency_tracer::segment_name((latency_segment)k),
+                       p.p50, p.p99, p.max, last[latency_tracer::percentile_index(window, 50)],
+                       last[latency_tracer::percentile_index(window, 99)], last[window - 1]);
+                mismatches++;
+            }
+        }
+        return mismatches;
+    }
+
+    const unsigned int _nframes;
+    const uint32_t _period_us;
+    std::vector<int16_t> _frames;
+
+    mock_bus _bus;
+    MAX25x05 _sensor;
+    gesture_lib _gesture;
+    mouse_output _mouse;
+    latency_tracer _tracer;
+
+    uint32_t _sequence = 0;
+    std::deque<sim_frame> _queue;
+    uint64_t _busy_until_us = 0;
+
+    std::vector<uint32_t> _expected[LATENCY_NUM_SEGMENTS];
+    unsigned int _processed = 0, _dropped = 0, _overruns = 0, _incomplete = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    unsigned int nframes = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 0) : 4096;
+    uint32_t period_us = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 10000;
+    if (nframes == 0 || period_us < 1000) {
+        printf("usage: %s [frames] [period_us >= 1000]\n", argv[0]);
+        return 1;
+    }
+
+    static latency_sim sim(nframes, period_us);
+    unsigned int mismatches = sim.run();
+    printf("%s\n", mismatches == 0 ? "verify: all equal" : "verify: MISMATCH");
+    return mismatches == 0 ? 0 : 1;
+}
@@ -1,122 +1,333 @@
-/* mbed Microcontroller Library
- * Copyright (c) 2019 ARM Limited
- * SPDX-License-Identifier: Apache-2.0
- *
- * Application: Gesture Mouse Library test program BETA
- * Author: C Gerrish @December 2022
-*
-* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
-* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
-* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
-* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
-* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
-* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
-* OTHER DEALINGS IN THE SOFTWARE.
-*
-* Microcontroller used: MAX32620FTHR
-* Target sensor: MAX25405 Gesture Sensor Kit
-* 
-* Except as contained in this notice, the name of Maxim Integrated
-* Products, Inc. shall not be used except as stated in the Maxim Integrated
-* Products, Inc. Branding Policy.
-*
-* The mere transfer of this software does not imply any licenses
-* of trade secrets, proprietary technology, copyrights, patents,
-* trademarks, maskwork rights, or any other form of intellectual
-* property whatsoever. Maxim Integrated Products, Inc. retains all
-* ownership rights.
-*/
-
-#include "mbed.h"
-//#include "USBSerial.h"
-#include "USBMouse.h"
-#include <cmath>
-
-// Uncomment one device option for library to know which sensor is attached
-//#define MAX25205_DEVICE
-#define MAX25405_DEVICE
-
-#include "MAX25x05.h"
-#include "gesture_lib.h"
-
-#define USE_SPI 1
-
-#if USE_SPI
-
-    #include <MAX25x05_SPI.h>
-
-    SPI MAXspi_1(P5_1, P5_2, P5_0); // mosi, miso, sclk
-    // The default settings of the SPI interface are 1MHz, 8-bit, Mode 0.
-    // The max SPI frequency for MAX25405 is 6MHz - in the library 2MHz (2e6) will be used
-    MAX25x05_SPI MAXIObus_1(MAXspi_1, 2e6, P5_5);
-
-    DigitalOut selPin(P3_2, 0);        // SEL pin is set low to indicate to MAX25x05 that it's to use SPI mode
-
-#else
-
-    #include <MAX25x05_I2C.h>
-
-    I2C MAXi2c_1(P3_4, P3_5);     // sda, scl   
-    // 
-    // The max I2C frequency for MAX25405 is 400k - in the library 100k (100e3) will be used
-    MAX25x05_I2C MAXIObus_1(MAXi2c_1, 100e3, P5_5, 0);
-
-    DigitalOut selPin(P3_2, 1);        // SEL pin is set high to indicate to MAX25x05 that it's to use I2C mode
-
-#endif
-
-// Bytes prefixed to pixel data to create data frame
-const int NUM_INFO_BYTES = 40;
-
-
-int main()
-{
-
-    //setup USB Serial comms for configuration option
-    //USBSerial serial(true, 0x0b6a, 0x4360, 0x0001);
-    USBMouse mouse(true, ABS_MOUSE, 0x0b6a, 0x4360, 0x0001);
-    //serial.set_blocking (true);
-
-    MAX25x05 max25x_1(MAXIObus_1, P5_3);            // Interrupt pin for sensor 1
-    //MAX25x05 max25x_2(MAXIObus_2, P3_3);            // Interrupt pin for sensor 2
-
-    // Use the gesture library to manipulate/prepare pixels for output
-    // ------------------------------------------------------------------
-    gesture_lib gesture_1(SENSOR_COLS, SENSOR_ROWS);
-    //int16_t pixels[NUM_SENSOR_PIXELS] = {'\0'};
-
-    // Note if using 2 gesture sensors then the LED timings need to change [TODO]
-    max25x_1.set_default_register_settings();           // Define for sensor number 1
-    //max25x_2.set_default_register_settings();         // Define for sensor number 2
-
-    max25x_1.enable_read_sensor_frames();
-    //max25x_2.enable_read_sensor_frames();
-
-    while (true) {
-        // If using INTB interrupt, the sensorDataReadyFlag will be set when the end-of-conversion occurs
-        if (max25x_1.sensorDataReadyFlag) {
-            // Check the interrupt pin to see if PWRON was set [[TODO]]
-            uint8_t newIntVal = 0;
-
-            max25x_1.getSensorPixelInts(gesture_1.pixels, false);
-            gesture_1.processGesture(WINDOW_FILTER_ALPHA, gesture_1.GEST_DYNAMIC);
-
-            //serial.printf("%u, %d, %d, %d, %d\r\n", gesture_1.dynamicResult.state, (int)(gesture_1.dynamicResult.cmx*100.0), 
-            //            (int)(gesture_1.dynamicResult.cmy*100.0), (int)sqrt((double)gesture_1.dynamicResult.CoM_Intensity), gesture_1.dynamicResult.maxpixel);
-                        
-            if (gesture_1.dynamicResult.state == 1 && gesture_1.dynamicResult.cmx >= 0 && gesture_1.dynamicResult.cmy >= 0) {
-                // Mouse movements
-                int threshold = (int)sqrt((double)gesture_1.dynamicResult.CoM_Intensity);
-                if (threshold > 50) {
-                    int16_t x = (int16_t)(gesture_1.dynamicResult.cmx*1800)+200;
-                    int16_t y = (int16_t)(gesture_1.dynamicResult.cmy*1800)+200;
-                    mouse.move(x, y);
-                }
-            }
-
-            memset(gesture_1.pixels, '\0', NUM_SENSOR_PIXELS);
-            
-            max25x_1.sensorDataReadyFlag = false;
-        }
-    }
-}
+/* mbed Microcontroller Library
+ * Copyright (c) 2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Application: Gesture Mouse Library test program BETA
+ * Author: C Gerrish @December 2022
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Microcontroller used: MAX32620FTHR
+* Target sensor: MAX25405 Gesture Sensor Kit
+* 
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*/
+
+#include "mbed.h"
+//#include "USBSerial.h"
+#include "USBMouse.h"
+#include <cmath>
+
+// Sensor attached, selects the register defaults (MAX25X05_DEVICE_MAX25205 or MAX25X05_DEVICE_MAX25405)
+#define SENSOR_DEVICE_TYPE MAX25X05_DEVICE_MAX25405
+
+#include "MAX25x05.h"
+#include "gesture_lib.h"
+#include "mouse_output.h"
+
+// MOUSE_OUTPUT_ABSOLUTE: the cursor follows the hand across the screen; MOUSE_OUTPUT_RELATIVE: the hand moves
+// the cursor like a mouse. Reports are coalesced to the USB polling interval (mouse_output.h).
+#define MOUSE_MODE MOUSE_OUTPUT_ABSOLUTE
+
+#define USE_SPI 1
+
+// 1: INTB wakes an acquisition thread that queues timestamped frames for the main (processing) thread
+// 0: the main loop polls the sensor flags itself
+#define USE_RTOS_PIPELINE 1
+
+#if USE_RTOS_PIPELINE
+    #include "gesture_pipeline.h"
+#endif
+
+// GESTURE_PROFILE 1 (mbed_app.json "stage-profiler") times the processing stages (stage_profiler.h) and
+// reports them every GESTURE_PROFILE_REPORT_FRAMES frames: as profile packets in the frame stream, or
+// printed on the console without it
+#include "stage_profiler.h"
+
+#if GESTURE_PROFILE
+    #ifndef GESTURE_PROFILE_REPORT_FRAMES
+    #define GESTURE_PROFILE_REPORT_FRAMES 1024
+    #endif
+#endif
+
+// GESTURE_LATENCY_TRACE 1 (mbed_app.json "latency-tracer") timestamps every frame from the INTB interrupt to the
+// mouse report (latency_tracer.h) and prints p50/p99/max latency and the processing overruns every
+// GESTURE_LATENCY_REPORT_FRAMES frames. Needs the RTOS pipeline for the frame sequence numbers, and is not
+// printed while the frame stream has the UART.
+#ifndef GESTURE_LATENCY_TRACE
+#define GESTURE_LATENCY_TRACE 0
+#endif
+
+#if GESTURE_LATENCY_TRACE
+    #include "latency_tracer.h"
+
+    #ifndef GESTURE_LATENCY_REPORT_FRAMES
+    #define GESTURE_LATENCY_REPORT_FRAMES 1024
+    #endif
+#endif
+
+// 1: the sensor runs a slow idle sequencer profile until something comes into view (mbed_app.json "adaptive-frame-rate")
+#ifndef MAX25X05_ADAPTIVE_RATE
+#define MAX25X05_ADAPTIVE_RATE 1
+#endif
+
+#if MAX25X05_ADAPTIVE_RATE
+    #include "MAX25x05AdaptiveRate.h"
+#endif
+
+// 1: each raw sensor frame is also sent to the host as a binary frame stream packet (frame_stream.h)
+// on the UART at FRAME_STREAM_BAUD (mbed_app.json "frame-stream-baud"), decoded with host/tools/frame_stream_decode
+#define OUTPUT_FRAME_STREAM 0
+
+#if OUTPUT_FRAME_STREAM
+    #include "frame_stream.h"
+
+    #ifndef FRAME_STREAM_BAUD
+    #define FRAME_STREAM_BAUD 921600
+    #endif
+#endif
+
+#if USE_SPI
+
+    #include <MAX25x05_SPI.h>
+
+    SPI MAXspi_1(P5_1, P5_2, P5_0); // mosi, miso, sclk
+    // The default settings of the SPI interface are 1MHz, 8-bit, Mode 0.
+    // The max SPI frequency for MAX25405 is 6MHz (MAX25X05_SPI_MAX_HZ), pixel frames are read in one burst
+    MAX25x05_SPI MAXIObus_1(MAXspi_1, MAX25X05_SPI_MAX_HZ, P5_5);
+
+    DigitalOut selPin(P3_2, 0);        // SEL pin is set low to indicate to MAX25x05 that it's to use SPI mode
+
+#else
+
+    #include <MAX25x05_I2C.h>
+
+    I2C MAXi2c_1(P3_4, P3_5);     // sda, scl   
+    // 
+    // The max I2C frequency for MAX25405 is 400k (Fast mode). Frames are read in one combined transaction; the
+    // INTB interrupt cannot start an I2C transfer, so the main loop reads them after sensorDataReadyFlag.
+    // CSB low selects address 0x9E, high 0xA0, so a second sensor with the other CSB level can share MAXi2c_1.
+    MAX25x05_I2C MAXIObus_1(MAXi2c_1, MAX25X05_I2C_FAST_HZ, P5_5, 0);
+
+    DigitalOut selPin(P3_2, 1);        // SEL pin is set high to indicate to MAX25x05 that it's to use I2C mode
+
+#endif
+
+#if OUTPUT_FRAME_STREAM
+    // Sequence number and timestamp are sent ahead of the pixel data (frame_stream.h header)
+    static BufferedSerial stream_port(USBTX, USBRX, FRAME_STREAM_BAUD);
+    static frame_stream_encoder stream_encoder(true);       // delta/zig-zag encoded with periodic key frames
+    static uint8_t stream_packet[FRAME_STREAM_MAX_ENCODED_BYTES(NUM_SENSOR_PIXELS)];
+    static frame_stream_info stream_info;          // Device type and register settings, for recordings on the host
+    static uint32_t stream_frames = 0;
+#endif
+
+#if GESTURE_PROFILE
+static void report_profile()
+{
+#if OUTPUT_FRAME_STREAM
+    // One profile packet per stage, the console shares the UART with the stream
+    const stage_profiler &profiler = gesture_profiler();
+    for (unsigned int k = 0; k < PROFILE_NUM_STAGES; k++) {
+        const profile_stage stage = (profile_stage)k;
+        const profile_stage_stats &stats = profiler.stats(stage);
+        if (stats.count == 0) continue;
+
+        frame_stream_profile profile;
+        profile.stage = (uint8_t)k;
+        strncpy(profile.name, stage_profiler::stage_name(stage), FRAME_STREAM_MAX_STAGE_NAME);
+        profile.name[FRAME_STREAM_MAX_STAGE_NAME] = '\0';
+        profile.ticks_per_us = stage_profiler::ticks_per_us();
+        profile.count = stats.count;
+        profile.min = stats.min;
+        profile.avg = profiler.average(stage);
+        profile.max = stats.max;
+        profile.num_buckets = STAGE_PROFILER_BUCKETS;
+        memcpy(profile.buckets, stats.buckets, sizeof(stats.buckets));
+        size_t profile_bytes = stream_encoder.encode_profile(profile, stream_packet);
+        stream_port.write(stream_packet, profile_bytes);
+    }
+#else
+    gesture_profiler().print();
+#endif
+}
+#endif
+
+
+int main()
+{
+
+    //setup USB Serial comms for configuration option
+    //USBSerial serial(true, 0x0b6a, 0x4360, 0x0001);
+    USBMouse mouse(true, MOUSE_MODE == MOUSE_OUTPUT_RELATIVE ? REL_MOUSE : ABS_MOUSE, 0x0b6a, 0x4360, 0x0001);
+    static mouse_output mouse_1(MOUSE_MODE);
+    //serial.set_blocking (true);
+
+    MAX25x05 max25x_1(MAXIObus_1, P5_3, SENSOR_DEVICE_TYPE);            // Interrupt pin for sensor 1
+    //MAX25x05 max25x_2(MAXIObus_2, P3_3, SENSOR_DEVICE_TYPE);            // Interrupt pin for sensor 2
+
+    // Use the gesture library to manipulate/prepare pixels for output
+    // ------------------------------------------------------------------
+    // Static so the gesture buffers show up in the link map rather than on the main stack
+    static gesture_lib gesture_1(SENSOR_COLS, SENSOR_ROWS);
+    //int16_t pixels[NUM_SENSOR_PIXELS] = {'\0'};
+
+    // For 2-4 gesture sensors use MAX25x05Array (MAX25x05Array.h) instead: it staggers the conversions so
+    // the LED pulses of the sensors don't interfere, e.g.
+    //   sensors.add_sensor(MAXIObus_1, P5_3, SENSOR_DEVICE_TYPE); sensors.add_sensor(MAXIObus_2, P3_3, SENSOR_DEVICE_TYPE);
+    //   sensors.set_default_register_settings(); if (!sensors.start()) { /* see MAX25x05Array::start() */ }
+    //   if (sensors.frames_ready()) { sensors.read_frames(); sensors.copy_stitched_frame(gesture_wide); }
+    // with basic_gesture_lib<SENSOR_COLS*2, SENSOR_ROWS> gesture_wide, and sensors.check_schedule() now and then.
+    // Sensors sharing an SPI bus take the same lock: MAX25x05_SPI MAXIObus_2(MAXspi_1, MAX25X05_SPI_MAX_HZ, cs_2_pin, &sensors.bus_lock(0))
+#if GESTURE_PROFILE
+    stage_profiler::start_counter();
+#endif
+
+    max25x_1.set_default_register_settings();           // Define for sensor number 1
+    //max25x_2.set_default_register_settings();         // Define for sensor number 2
+
+#if MAX25X05_ADAPTIVE_RATE
+    // Fast frames from a maxpixel of START_DETECTION_THRESHOLD until it has been below END_DETECTION_THRESHOLD for a while
+    static MAX25x05AdaptiveRate rate_1(START_DETECTION_THRESHOLD, END_DETECTION_THRESHOLD, max25x_1.device_type());
+    max25x_1.set_sequence_profile(rate_1.profile());
+#if !USE_RTOS_PIPELINE
+    bool profile_pending = false;       // Switch waiting for the bus to be free between two frames
+#endif
+#endif
+
+#if USE_RTOS_PIPELINE
+    // The acquisition thread reads each frame as soon as INTB fires; frames that arrive while this
+    // thread is processing wait in the queue. Both threads sleep until the next conversion.
+    static gesture_pipeline pipeline_1(max25x_1);
+    static sensor_frame frame_1;
+#if GESTURE_LATENCY_TRACE
+    static latency_tracer latency_1;
+    pipeline_1.set_latency_tracer(&latency_1);
+#endif
+    pipeline_1.start();
+#else
+    // The end-of-conversion interrupt starts an asynchronous pixel read, so the bus transfer runs while
+    // the loop below is still busy with the previous frame (falls back to sensorDataReadyFlag on buses without async reads)
+    max25x_1.enable_read_sensor_frames(true);
+#endif
+    //max25x_2.enable_read_sensor_frames();
+
+    while (true) {
+        bool newFrame = false;
+
+#if USE_RTOS_PIPELINE
+        pipeline_1.get_frame(frame_1);
+        memcpy(gesture_1.pixels, frame_1.pixels, sizeof(frame_1.pixels));
+        newFrame = true;
+        uint32_t frame_sequence = frame_1.sequence;
+        uint32_t frame_timestamp_us = frame_1.timestamp_us;
+#else
+        if (max25x_1.sensorReadCompleteFlag) {
+            max25x_1.sensorReadCompleteFlag = false;
+            max25x_1.getLastSensorPixelInts(gesture_1.pixels, false);
+            newFrame = true;
+        }
+        // If using INTB interrupt, the sensorDataReadyFlag will be set when the end-of-conversion occurs
+        else if (max25x_1.sensorDataReadyFlag) {
+            max25x_1.sensorDataReadyFlag = false;
+            GESTURE_PROFILE_BEGIN(t_read);
+            newFrame = max25x_1.getSensorPixelInts(gesture_1.pixels, false) == 0;
+            GESTURE_PROFILE_END(PROFILE_READ, t_read);
+        }
+#if MAX25X05_ADAPTIVE_RATE
+        // The frame has just been read and the next read only starts at the next end-of-conversion, so
+        // the bus is free now. If a read is running after all, the write fails and is tried next frame.
+        if (newFrame && profile_pending && max25x_1.set_sequence_profile(rate_1.profile()) == 0) profile_pending = false;
+#endif
+        static uint32_t frame_sequence = 0;
+        if (newFrame) frame_sequence++;
+        uint32_t frame_timestamp_us = us_ticker_read();
+#endif
+
+        if (newFrame) {
+            GESTURE_PROFILE_BEGIN(t_frame);
+#if OUTPUT_FRAME_STREAM
+            if (stream_frames++ % FRAME_STREAM_INFO_INTERVAL == 0) {
+                // The registers as last written, so a recording sees the profile switches of the adaptive rate
+                MAX25x05_RegisterSetting registers[FRAME_STREAM_MAX_REGISTERS];
+                size_t num_registers = max25x_1.register_settings(registers, FRAME_STREAM_MAX_REGISTERS);
+                stream_info.device_type = max25x_1.device_type();
+                stream_info.cols = SENSOR_COLS;
+                stream_info.rows = SENSOR_ROWS;
+                stream_info.num_registers = (uint8_t)num_registers;
+                memcpy(stream_info.registers, registers, num_registers * sizeof(MAX25x05_RegisterSetting));
+                size_t info_bytes = stream_encoder.encode_info(stream_info, stream_packet);
+                stream_port.write(stream_packet, info_bytes);
+            }
+            // Raw frame, before processGesture() filters gesture_1.pixels in place
+            size_t stream_bytes = stream_encoder.encode(frame_sequence, frame_timestamp_us, gesture_1.pixels, NUM_SENSOR_PIXELS, stream_packet);
+            stream_port.write(stream_packet, stream_bytes);
+#endif
+
+            // Check the interrupt pin to see if PWRON was set [[TODO]]
+            uint8_t newIntVal = 0;
+
+            // Tracking filters the centroid and predicts it a frame ahead, so the cursor neither jitters
+            // nor lags behind the window filter
+            gesture_1.processGesture(WINDOW_FILTER_ALPHA, gesture_1.GEST_TRACKING);
+#if GESTURE_LATENCY_TRACE && USE_RTOS_PIPELINE
+            latency_1.mark(frame_sequence, LATENCY_PROCESS_END);
+#endif
+
+#if MAX25X05_ADAPTIVE_RATE
+            if (rate_1.update(gesture_1.dynamicResult.maxpixel)) {
+#if USE_RTOS_PIPELINE
+                pipeline_1.set_sequence_profile(rate_1.profile());
+#else
+                // INTB may start a pixel read at any time while the frame is processed, so the switch
+                // waits until the next frame has been read
+                profile_pending = true;
+#endif
+            }
+#endif
+
+            //serial.printf("%u, %d, %d, %d, %d\r\n", gesture_1.dynamicResult.state, (int)(gesture_1.dynamicResult.cmx*100.0), 
+            //            (int)(gesture_1.dynamicResult.cmy*100.0), (int)sqrt((double)gesture_1.dynamicResult.CoM_Intensity), gesture_1.dynamicResult.maxpixel);
+                        
+            // Mouse movements: only once per USB polling interval, and only when the cursor moves
+            mouse_1.update(gesture_1.trackingResult, gesture_1.dynamicResult.CoM_Intensity);
+            int16_t mouse_x, mouse_y;
+            if (mouse_1.poll(us_ticker_read(), mouse_x, mouse_y)) {
+                GESTURE_PROFILE_BEGIN(t_output);
+                mouse.move(mouse_x, mouse_y);
+                GESTURE_PROFILE_END(PROFILE_OUTPUT, t_output);
+#if GESTURE_LATENCY_TRACE && USE_RTOS_PIPELINE
+                latency_1.mark(frame_sequence, LATENCY_HID_SUBMIT);
+#endif
+            }
+
+            memset(gesture_1.pixels, '\0', NUM_SENSOR_PIXELS);
+            GESTURE_PROFILE_END(PROFILE_FRAME, t_frame);
+
+#if GESTURE_PROFILE
+            // Outside the frame time; the stats keep accumulating across reports
+            if (frame_sequence % GESTURE_PROFILE_REPORT_FRAMES == 0) report_profile();
+#endif
+#if GESTURE_LATENCY_TRACE && USE_RTOS_PIPELINE
+            latency_1.frame_done(frame_sequence);
+#if !OUTPUT_FRAME_STREAM
+            if (frame_sequence % GESTURE_LATENCY_REPORT_FRAMES == 0) latency_1.print();
+#endif
+#endif
+        }
+    }
+}
@@ -0,0 +1,113 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* mouse_output: turns the tracked centroid into USBMouse reports
+*/
+
+#include "mouse_output.h"
+
+bool mouse_output::update(const gesture_lib_types::TrackingResult &tracking, const uint32_t com_intensity)
+{
+    if (!qualifies(tracking, com_intensity)) {
+        _prev_valid = false;    // the next track starts from where it is seen again, not with a jump
+        return false;
+    }
+    _updates++;
+
+    if (_mode == MOUSE_OUTPUT_ABSOLUTE) {
+        _target_x = to_q8(tracking.px * abs_scale + abs_offset);
+        _target_y = to_q8(tracking.py * abs_scale + abs_offset);
+        _target_valid = true;
+    }
+    else {
+        if (_prev_valid) {
+            _acc_x += to_q8((tracking.px - _prev_x) * rel_gain);
+            _acc_y += to_q8((tracking.py - _prev_y) * rel_gain);
+        }
+        _prev_x = tracking.px;
+        _prev_y = tracking.py;
+        _prev_valid = true;
+    }
+    return true;
+}
+
+bool mouse_output::poll(const uint32_t now_us, int16_t &x, int16_t &y)
+{
+    if (_any_report && now_us - _last_report_us < _interval_us) return false;
+
+    if (_mode == MOUSE_OUTPUT_ABSOLUTE) {
+        if (!_target_valid) return false;
+        if (_reported_valid) {
+            const int32_t dx = _target_x - _reported_x * 256, dy = _target_y - _reported_y * 256;
+            if (dx < MOUSE_OUTPUT_ABS_HYSTERESIS_Q8 && dx > -MOUSE_OUTPUT_ABS_HYSTERESIS_Q8 &&
+                dy < MOUSE_OUTPUT_ABS_HYSTERESIS_Q8 && dy > -MOUSE_OUTPUT_ABS_HYSTERESIS_Q8) {
+                return false;
+            }
+        }
+        int32_t rx = round_q8(_target_x), ry = round_q8(_target_y);
+        rx = rx < 0 ? 0 : (rx > INT16_MAX ? INT16_MAX : rx);
+        ry = ry < 0 ? 0 : (ry > INT16_MAX ? INT16_MAX : ry);
+        if (_reported_valid && rx == _reported_x && ry == _reported_y) return false;
+        _reported_x = rx;
+        _reported_y = ry;
+        _reported_valid = true;
+        x = (int16_t)rx;
+        y = (int16_t)ry;
+    }
+    else {
+        int32_t dx = round_q8(_acc_x), dy = round_q8(_acc_y);
+        if (dx == 0 && dy == 0) return false;
+        dx = dx > MOUSE_OUTPUT_REL_MAX ? MOUSE_OUTPUT_REL_MAX : (dx < -MOUSE_OUTPUT_REL_MAX ? -MOUSE_OUTPUT_REL_MAX : dx);
+        dy = dy > MOUSE_OUTPUT_REL_MAX ? MOUSE_OUTPUT_REL_MAX : (dy < -MOUSE_OUTPUT_REL_MAX ? -MOUSE_OUTPUT_REL_MAX : dy);
+        _acc_x -= dx * 256;
+        _acc_y -= dy * 256;
+        x = (int16_t)dx;
+        y = (int16_t)dy;
+    }
+
+    _last_report_us = now_us;
+    _any_report = true;
+    _reports++;
+    return true;
+}
+
+void mouse_output::reset()
+{
+    _target_valid = false;
+    _reported_valid = false;
+    _prev_valid = false;
+    _acc_x = _acc_y = 0;
+}
@@ -0,0 +1,138 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* mouse_output: turns the tracked centroid into USBMouse reports
+*
+* update() takes the tracking result of every processed frame; poll() hands out a report at most once
+* per USB polling interval and only when the pointer has moved, so frames that arrive within one
+* interval are coalesced into a single report and a still hand sends nothing. The position is kept in
+* Q8 fixed point (1/256 of a report count):
+*  - MOUSE_OUTPUT_ABSOLUTE maps the predicted position (trackingResult px/py) to abs_scale * p + abs_offset
+*    and reports it rounded, after it has moved at least MOUSE_OUTPUT_ABS_HYSTERESIS_Q8 from the last
+*    report, so a position halfway between two counts does not dither between them
+*  - MOUSE_OUTPUT_RELATIVE accumulates rel_gain * (change of position) from frame to frame and reports
+*    the whole counts, carrying the fraction to the next report, so slow movements are not lost to
+*    truncation. A report moves at most MOUSE_OUTPUT_REL_MAX counts per axis (one HID report), the
+*    rest follows in the next ones.
+* A frame only moves the pointer while the object is tracked, inside the array and bright enough:
+* CoM_Intensity >= MOUSE_OUTPUT_MIN_INTENSITY, the integer form of sqrt(CoM_Intensity) > MOUSE_OUTPUT_MIN_AMPLITUDE.
+*/
+
+#ifndef __MOUSE_OUTPUT_H__
+#define __MOUSE_OUTPUT_H__
+
+#include "mbed.h"
+#include "gesture_lib.h"
+#include <cstdint>
+
+// Polling interval of the HID interrupt endpoint (bInterval), reports are coalesced to it
+#ifndef MOUSE_OUTPUT_INTERVAL_US
+#define MOUSE_OUTPUT_INTERVAL_US                (1000u)
+#endif
+
+#define MOUSE_OUTPUT_MIN_AMPLITUDE              (50u)       // sqrt(CoM_Intensity) must be above this
+#define MOUSE_OUTPUT_MIN_INTENSITY              ((MOUSE_OUTPUT_MIN_AMPLITUDE + 1u) * (MOUSE_OUTPUT_MIN_AMPLITUDE + 1u))
+
+#define MOUSE_OUTPUT_ABS_SCALE                  (1800.0F)   // Report counts per sensor pixel
+#define MOUSE_OUTPUT_ABS_OFFSET                 (200.0F)
+#define MOUSE_OUTPUT_ABS_HYSTERESIS_Q8          (192)       // 0.75 count
+#define MOUSE_OUTPUT_REL_GAIN                   (200.0F)    // Counts per sensor pixel of movement
+#define MOUSE_OUTPUT_REL_MAX                    (127)
+
+typedef enum {
+    MOUSE_OUTPUT_ABSOLUTE,          // USBMouse ABS_MOUSE
+    MOUSE_OUTPUT_RELATIVE           // USBMouse REL_MOUSE
+} mouse_output_mode;
+
+class mouse_output
+{
+
+public:
+    mouse_output(const mouse_output_mode mode = MOUSE_OUTPUT_ABSOLUTE, const uint32_t interval_us = MOUSE_OUTPUT_INTERVAL_US):
+        _mode(mode), _interval_us(interval_us) {}
+
+    float abs_scale = MOUSE_OUTPUT_ABS_SCALE;
+    float abs_offset = MOUSE_OUTPUT_ABS_OFFSET;
+    float rel_gain = MOUSE_OUTPUT_REL_GAIN;
+
+    // Whether a frame moves the pointer, as the sqrt gate of the original main loop
+    static bool qualifies(const gesture_lib_types::TrackingResult &tracking, const uint32_t com_intensity)
+    {
+        return tracking.state == 1 && tracking.px >= 0 && tracking.py >= 0 && com_intensity >= MOUSE_OUTPUT_MIN_INTENSITY;
+    }
+
+    // Takes the result of a processed frame. Returns qualifies().
+    bool update(const gesture_lib_types::TrackingResult &tracking, const uint32_t com_intensity);
+
+    // Report due at now_us: true with the x, y to pass to USBMouse::move()
+    bool poll(const uint32_t now_us, int16_t &x, int16_t &y);
+
+    // Forgets the position and any pending movement, e.g. when switching mode
+    void reset(void);
+    void set_mode(const mouse_output_mode mode) { _mode = mode; reset(); }
+    mouse_output_mode mode(void) const { return _mode; }
+
+    // Counters
+    uint32_t updates(void) const { return _updates; }       // Qualifying frames
+    uint32_t reports(void) const { return _reports; }       // Reports handed out by poll()
+
+private:
+    static int32_t to_q8(const float v) { return (int32_t)(v * 256.0F + (v < 0 ? -0.5F : 0.5F)); }
+    static int32_t round_q8(const int32_t q8) { return (q8 + 128) >> 8; }
+
+    mouse_output_mode _mode;
+    const uint32_t _interval_us;
+
+    // Absolute: target and last reported position, Q8 and counts
+    int32_t _target_x = 0, _target_y = 0;
+    int32_t _reported_x = 0, _reported_y = 0;
+    bool _target_valid = false, _reported_valid = false;
+
+    // Relative: previous tracked position and the movement not reported yet, Q8
+    float _prev_x = 0, _prev_y = 0;
+    bool _prev_valid = false;
+    int32_t _acc_x = 0, _acc_y = 0;
+
+    uint32_t _last_report_us = 0;
+    bool _any_report = false;
+
+    uint32_t _updates = 0;
+    uint32_t _reports = 0;
+
+};
+
+
+#endif // __MOUSE_OUTPUT_H__
@@ -0,0 +1,132 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Fixed capacity single-producer / single-consumer ring of frames
+*
+* One thread (or interrupt) writes, one thread reads, and neither ever blocks or takes a lock: the
+* producer only moves _head and the consumer only moves _tail. Slots can be filled and drained in
+* place (write_slot/commit, read_slot/release) so a frame is never copied through the queue.
+*/
+
+#ifndef __FRAME_QUEUE_H__
+#define __FRAME_QUEUE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+template <typename T, uint32_t Capacity>
+class frame_queue
+{
+
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "frame_queue capacity must be a power of two");
+
+    frame_queue(): _head(0), _tail(0) {};
+
+    frame_queue(const frame_queue &) = delete;
+    frame_queue &operator=(const frame_queue &) = delete;
+
+    /*
+    * Producer side
+    */
+
+    // Free slot to fill, or NULL if the queue is full. The slot is published by commit()
+    T *write_slot(void)
+    {
+        const uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= Capacity) return NULL;
+        return &_slots[head & (Capacity - 1)];
+    }
+
+    void commit(void)
+    {
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool push(const T &item)
+    {
+        T *slot = write_slot();
+        if (slot == NULL) return false;
+        *slot = item;
+        commit();
+        return true;
+    }
+
+    /*
+    * Consumer side
+    */
+
+    // Oldest queued item, or NULL if the queue is empty. The slot is handed back by release()
+    const T *read_slot(void)
+    {
+        const uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) == tail) return NULL;
+        return &_slots[tail & (Capacity - 1)];
+    }
+
+    void release(void)
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool pop(T &item)
+    {
+        const T *slot = read_slot();
+        if (slot == NULL) return false;
+        item = *slot;
+        release();
+        return true;
+    }
+
+    // Either side
+    uint32_t size(void) const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity(void) { return Capacity; }
+
+private:
+    T _slots[Capacity];
+
+    std::atomic<uint32_t> _head;    // Next slot to write, only modified by the producer
+    std::atomic<uint32_t> _tail;    // Next slot to read, only modified by the consumer
+
+};
+
+
+#endif  // __FRAME_QUEUE_H__
@@ -0,0 +1,155 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Interrupt driven acquisition pipeline for a MAX25x05 sensor (Mbed OS RTOS)
+*/
+
+#include "gesture_pipeline.h"
+#include "stage_profiler.h"
+
+void gesture_pipeline::start() {
+    _consumer = ThisThread::get_id();
+    _clock.start();
+    _acq_thread.start(callback(this, &gesture_pipeline::acquisition_thread));
+
+    _sensor.attach_read_complete(callback(this, &gesture_pipeline::read_done_handler));
+    _sensor.attach_data_ready(callback(this, &gesture_pipeline::intb_handler));
+    _sensor.enable_read_sensor_frames();
+}
+
+void gesture_pipeline::get_frame(sensor_frame &frame) {
+    while (!_queue.pop(frame)) {
+        ThisThread::flags_wait_any(FRAME_READY_FLAG);
+    }
+}
+
+void gesture_pipeline::set_sequence_profile(const MAX25x05_SequenceProfile &profile) {
+    core_util_critical_section_enter();
+    _profile = profile;
+    _profile_pending = true;
+    core_util_critical_section_exit();
+}
+
+/*
+* End-of-conversion interrupt: record when the frame completed and wake the acquisition thread
+*/
+void gesture_pipeline::intb_handler() {
+    if (_intb_pending) _missed_conversions++;       // previous frame not read yet, it is now overwritten
+    _intb_timestamp_us = (uint32_t)_clock.elapsed_time().count();
+    _sequence++;
+    if (_tracer != NULL) _tracer->mark(_sequence, LATENCY_INTERRUPT);
+    _intb_pending = true;
+    _acq_thread.flags_set(ACQ_FLAG);
+}
+
+/*
+* Asynchronous pixel read finished, successfully or not: wake the acquisition thread waiting for it
+*/
+void gesture_pipeline::read_done_handler() {
+    _acq_thread.flags_set(READ_DONE_FLAG);
+}
+
+void gesture_pipeline::acquisition_thread() {
+    while (true) {
+        ThisThread::flags_wait_any(ACQ_FLAG);
+
+        core_util_critical_section_enter();
+        uint32_t timestamp_us = _intb_timestamp_us;
+        uint32_t sequence = _sequence;
+        _intb_pending = false;
+        core_util_critical_section_exit();
+
+        sensor_frame *slot = _queue.write_slot();
+        if (slot == NULL) {
+            _queue_overruns++;
+            apply_pending_profile();        // the consumer is behind, which is when a switch matters most
+            continue;
+        }
+
+        slot->sequence = sequence;
+        slot->timestamp_us = timestamp_us;
+        if (_tracer != NULL) _tracer->mark(sequence, LATENCY_READ_START);
+        GESTURE_PROFILE_BEGIN(t_read);
+        bool read_ok = read_frame(slot->pixels);
+        GESTURE_PROFILE_END(PROFILE_READ, t_read);
+        if (_tracer != NULL) _tracer->mark(sequence, LATENCY_READ_END);
+        if (!read_ok) {
+            _read_failures++;
+            apply_pending_profile();
+            continue;
+        }
+        _queue.commit();
+        _frames_acquired++;
+
+        osThreadFlagsSet(_consumer, FRAME_READY_FLAG);
+
+        apply_pending_profile();
+    }
+}
+
+/*
+* Reads the frame that just completed. The asynchronous read lets the consumer run while the SPI
+* transfer is in flight; without one (I2C) or after a failed transfer the frame is read blocking,
+* which still works until the next conversion ends.
+*/
+bool gesture_pipeline::read_frame(int16_t pixels[]) {
+    _sensor.sensorReadCompleteFlag = false;
+    _sensor.sensorDataReadyFlag = false;
+    if (_sensor.startSensorPixelRead() == 0) {
+        ThisThread::flags_wait_any(READ_DONE_FLAG);
+        if (_sensor.sensorReadCompleteFlag) {
+            _sensor.sensorReadCompleteFlag = false;
+            _sensor.getLastSensorPixelInts(pixels, _flip);
+            return true;
+        }
+        _sensor.sensorDataReadyFlag = false;
+    }
+    return _sensor.getSensorPixelInts(pixels, _flip) == 0;
+}
+
+/*
+* Writes a profile from set_sequence_profile(), on every wake-up of the acquisition thread whether or
+* not the frame was read, so the write always falls just after an end-of-conversion
+*/
+void gesture_pipeline::apply_pending_profile() {
+    if (!_profile_pending) return;
+
+    core_util_critical_section_enter();
+    MAX25x05_SequenceProfile profile = _profile;
+    _profile_pending = false;
+    core_util_critical_section_exit();
+    _sensor.set_sequence_profile(profile);
+}
@@ -0,0 +1,150 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* Interrupt driven acquisition pipeline for a MAX25x05 sensor (Mbed OS RTOS)
+*
+* The INTB end-of-conversion interrupt only timestamps the frame and sets a thread flag. The
+* acquisition thread then starts an asynchronous (SPI) pixel read into the driver and sleeps until it
+* completes, so the consumer has the CPU during the transfer, converts the frame straight into a slot
+* of a lock-free frame_queue and wakes the consumer, which takes frames with get_frame(). Where the bus
+* cannot read asynchronously (I2C) or the transfer fails, the frame is read blocking instead. Both
+* threads block on thread flags while waiting, so the MCU sleeps between frames, and a consumer that
+* falls behind catches up from the queue instead of losing the frames that arrived while it was busy.
+*
+* Drop policy: the queue absorbs a consumer that is up to GESTURE_PIPELINE_QUEUE_DEPTH frames behind.
+* Past that the newest frame is dropped and counted in queue_overruns(); the producer does not block,
+* because the sensor keeps converting and a frame not read before the next INTB is lost anyway, only
+* later and uncounted. Frames already queued are never overwritten, so the consumer sees a gap in the
+* sequence numbers rather than a reordered stream.
+*/
+
+#ifndef __GESTURE_PIPELINE_H__
+#define __GESTURE_PIPELINE_H__
+
+#include "mbed.h"
+#include "MAX25x05.h"
+#include "frame_queue.h"
+#include "latency_tracer.h"
+
+// Frames buffered between acquisition and processing (mbed_app.json "pipeline-queue-depth")
+#ifndef GESTURE_PIPELINE_QUEUE_DEPTH
+#define GESTURE_PIPELINE_QUEUE_DEPTH            (8u)
+#endif
+
+// Acquisition thread stack in bytes (mbed_app.json "pipeline-acq-stack-size"). It holds the frame
+// conversion, the driver and SPI/I2C call chain and, with GESTURE_PROFILE or GESTURE_LATENCY_TRACE,
+// their bookkeeping; leave headroom for the RTOS context and the exception frame.
+#ifndef GESTURE_PIPELINE_ACQ_STACK_SIZE
+#define GESTURE_PIPELINE_ACQ_STACK_SIZE         (4096u)
+#endif
+
+// One sensor frame as read at the end of a conversion
+typedef struct {
+    uint32_t sequence;                      // Conversion count since start(), gaps show lost frames
+    uint32_t timestamp_us;                  // Time of the INTB falling edge since start()
+    int16_t pixels[NUM_SENSOR_PIXELS];
+} sensor_frame;
+
+class gesture_pipeline
+{
+
+public:
+    gesture_pipeline(MAX25x05 &sensor, const bool flip_sensor_pixels = false):
+        _sensor(sensor), _flip(flip_sensor_pixels), _acq_thread(osPriorityAboveNormal, GESTURE_PIPELINE_ACQ_STACK_SIZE, NULL, "max25_acq")
+        {
+        };
+
+    // Starts acquisition. Must be called from the thread that will call get_frame().
+    void start(void);
+
+    // Blocks until a frame is available and copies it out (oldest first)
+    void get_frame(sensor_frame &frame);
+
+    // Has the acquisition thread write the sequencer profile at the next end-of-conversion, right after
+    // it has read the frame (or dropped it, queue full), so the sensor is only accessed from that thread
+    // and the write falls between two conversions
+    void set_sequence_profile(const MAX25x05_SequenceProfile &profile);
+
+    // Timestamps the interrupt and the pixel read of each frame (latency_tracer.h) under its sequence
+    // number; the consumer marks the rest. Set before start(), NULL for none.
+    void set_latency_tracer(latency_tracer *tracer) { _tracer = tracer; }
+
+    // Counters
+    uint32_t frames_acquired(void) const { return _frames_acquired; }
+    uint32_t queue_overruns(void) const { return _queue_overruns; }         // Frames dropped because the queue was full
+    uint32_t missed_conversions(void) const { return _missed_conversions; } // INTB again before the previous frame was read
+    uint32_t read_failures(void) const { return _read_failures; }           // Frames dropped because the pixel read failed
+    uint32_t queued_frames(void) const { return _queue.size(); }
+
+private:
+    void intb_handler(void);
+    void read_done_handler(void);
+    void acquisition_thread(void);
+    bool read_frame(int16_t pixels[]);
+    void apply_pending_profile(void);
+
+    static const uint32_t ACQ_FLAG =            (1u << 0);
+    static const uint32_t FRAME_READY_FLAG =    (1u << 1);
+    static const uint32_t READ_DONE_FLAG =      (1u << 2);
+
+    MAX25x05 &_sensor;
+    const bool _flip;
+    latency_tracer *_tracer = NULL;
+
+    Thread _acq_thread;
+    osThreadId_t _consumer = NULL;
+    Timer _clock;
+
+    frame_queue<sensor_frame, GESTURE_PIPELINE_QUEUE_DEPTH> _queue;
+
+    // Written by the interrupt, read by the acquisition thread
+    volatile bool _intb_pending = false;
+    volatile uint32_t _intb_timestamp_us = 0;
+    volatile uint32_t _missed_conversions = 0;
+    volatile uint32_t _sequence = 0;
+
+    // Written by the consumer, applied by the acquisition thread
+    MAX25x05_SequenceProfile _profile;
+    volatile bool _profile_pending = false;
+
+    uint32_t _frames_acquired = 0;
+    uint32_t _queue_overruns = 0;
+    uint32_t _read_failures = 0;
+
+};
+
+
+#endif  // __GESTURE_PIPELINE_H__
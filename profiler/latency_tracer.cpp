@@ -0,0 +1,134 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* latency_tracer: end-to-end latency from the end of a conversion to the mouse report
+*/
+
+#include "latency_tracer.h"
+#include <algorithm>
+
+void latency_tracer::mark_at(const uint32_t sequence, const latency_point point, const uint32_t timestamp_us)
+{
+    frame_record &r = _frames[sequence & (LATENCY_TRACER_SLOTS - 1)];
+    if (point == LATENCY_INTERRUPT) {
+        r.sequence = sequence;
+        r.valid = 0;
+        r.overrun = false;
+        _last_interrupt = sequence;
+    }
+    else if (r.sequence != sequence) {
+        return; // record already taken by a later conversion
+    }
+    else if (point == LATENCY_PROCESS_END) {
+        // A later conversion has already ended, its frame waits for this one
+        r.overrun = (int32_t)(_last_interrupt - sequence) > 0;
+    }
+    r.t[point] = timestamp_us;
+    r.valid |= 1u << point;
+}
+
+bool latency_tracer::frame_done(const uint32_t sequence)
+{
+    const frame_record &r = _frames[sequence & (LATENCY_TRACER_SLOTS - 1)];
+    const uint32_t processed = (1u << LATENCY_INTERRUPT) | (1u << LATENCY_READ_START) | (1u << LATENCY_READ_END) |
+                               (1u << LATENCY_PROCESS_END);
+    if (r.sequence != sequence || (r.valid & processed) != processed) return false;
+
+    _frames_done++;
+    if (r.overrun) _overruns++;
+    if (!(r.valid & (1u << LATENCY_HID_SUBMIT))) return true;
+
+    _reports++;
+    _window[LATENCY_WAKEUP][_window_next] = r.t[LATENCY_READ_START] - r.t[LATENCY_INTERRUPT];
+    _window[LATENCY_READOUT][_window_next] = r.t[LATENCY_READ_END] - r.t[LATENCY_READ_START];
+    _window[LATENCY_PROCESSING][_window_next] = r.t[LATENCY_PROCESS_END] - r.t[LATENCY_READ_END];
+    _window[LATENCY_OUTPUT][_window_next] = r.t[LATENCY_HID_SUBMIT] - r.t[LATENCY_PROCESS_END];
+    _window[LATENCY_TOTAL][_window_next] = r.t[LATENCY_HID_SUBMIT] - r.t[LATENCY_INTERRUPT];
+    _window_next = _window_next + 1 < LATENCY_TRACER_WINDOW ? _window_next + 1 : 0;
+    if (_window_count < LATENCY_TRACER_WINDOW) _window_count++;
+    return true;
+}
+
+void latency_tracer::reset()
+{
+    memset(_frames, 0, sizeof(_frames));
+    for (uint32_t k = 0; k < LATENCY_TRACER_SLOTS; k++) _frames[k].sequence = k + 1; // no record matches sequence k yet
+    _window_next = 0;
+    _window_count = 0;
+    _frames_done = 0;
+    _reports = 0;
+    _overruns = 0;
+}
+
+void latency_tracer::summary(latency_summary &out)
+{
+    out.frames = _frames_done;
+    out.reports = _reports;
+    out.overruns = _overruns;
+    out.window = _window_count;
+    for (unsigned int k = 0; k < LATENCY_NUM_SEGMENTS; k++) {
+        latency_percentiles &p = out.segments[k];
+        if (_window_count == 0) {
+            p.p50 = p.p99 = p.max = 0;
+            continue;
+        }
+        memcpy(_sorted, _window[k], _window_count * sizeof(uint32_t));
+        std::sort(_sorted, _sorted + _window_count);
+        p.p50 = _sorted[percentile_index(_window_count, 50)];
+        p.p99 = _sorted[percentile_index(_window_count, 99)];
+        p.max = _sorted[_window_count - 1];
+    }
+}
+
+const char *latency_tracer::segment_name(const latency_segment segment)
+{
+    static const char *names[LATENCY_NUM_SEGMENTS] = {"wakeup", "readout", "processing", "output", "total"};
+    return segment < LATENCY_NUM_SEGMENTS ? names[segment] : "?";
+}
+
+void latency_tracer::print()
+{
+    latency_summary s;
+    summary(s);
+    printf("latency: %lu frames, %lu reports, %lu overruns, last %lu reports:\r\n", (unsigned long)s.frames,
+           (unsigned long)s.reports, (unsigned long)s.overruns, (unsigned long)s.window);
+    printf("%-12s %10s %10s %10s\r\n", "segment", "p50 us", "p99 us", "max us");
+    for (unsigned int k = 0; k < LATENCY_NUM_SEGMENTS; k++) {
+        const latency_percentiles &p = s.segments[k];
+        printf("%-12s %10lu %10lu %10lu\r\n", segment_name((latency_segment)k), (unsigned long)p.p50, (unsigned long)p.p99,
+               (unsigned long)p.max);
+    }
+}
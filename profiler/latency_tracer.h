@@ -0,0 +1,170 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* latency_tracer: end-to-end latency from the end of a conversion to the mouse report
+*
+* Each frame is timestamped at five points, identified by its conversion sequence number (the
+* sensor_frame sequence of gesture_pipeline):
+*   LATENCY_INTERRUPT       INTB falling edge (MAX25x05::intb_handler, through the data ready callback)
+*   LATENCY_READ_START      the acquisition thread starts reading the pixels
+*   LATENCY_READ_END        the pixels are in the frame queue
+*   LATENCY_PROCESS_END     processGesture() has returned
+*   LATENCY_HID_SUBMIT      USBMouse::move() has returned
+* frame_done() closes a frame. Frames with a mouse report go into a rolling window of the last
+* LATENCY_TRACER_WINDOW frames, which summary() turns into p50/p99/max of the total latency (interrupt
+* to report) and of each segment in between. A frame whose processing ended after the interrupt of a
+* later conversion counts as an overrun, reported or not.
+*
+* Timestamps are microseconds from the clock function, us_ticker_read by default; the host
+* simulation (host/tools/latency_sim) passes a fake clock. Differences are taken modulo 2^32, so
+* the ticker wrapping around is harmless.
+*
+* mark() for a frame may be called from any one thread or interrupt at a time, as the pipeline does
+* (interrupt, then acquisition thread, then processing thread); a frame's record is overwritten once
+* LATENCY_TRACER_SLOTS later conversions have been marked. summary() and print() belong on the thread
+* that calls frame_done().
+*/
+
+#ifndef __LATENCY_TRACER_H__
+#define __LATENCY_TRACER_H__
+
+#include "mbed.h"
+#include <cstdint>
+
+// Frames in the rolling percentile window (mbed_app.json "latency-window")
+#ifndef LATENCY_TRACER_WINDOW
+#define LATENCY_TRACER_WINDOW                   (256u)
+#endif
+
+// Frames in flight between the interrupt and frame_done(), a power of two above the pipeline queue depth
+#define LATENCY_TRACER_SLOTS                    (32u)
+
+typedef enum {
+    LATENCY_INTERRUPT,
+    LATENCY_READ_START,
+    LATENCY_READ_END,
+    LATENCY_PROCESS_END,
+    LATENCY_HID_SUBMIT,
+    LATENCY_NUM_POINTS
+} latency_point;
+
+// Segments between consecutive points, then the whole path
+typedef enum {
+    LATENCY_WAKEUP,                 // Interrupt to read start
+    LATENCY_READOUT,                // Read start to read end
+    LATENCY_PROCESSING,             // Read end to process end, queueing included
+    LATENCY_OUTPUT,                 // Process end to HID submit
+    LATENCY_TOTAL,                  // Interrupt to HID submit
+    LATENCY_NUM_SEGMENTS
+} latency_segment;
+
+typedef struct {
+    uint32_t p50;                   // us
+    uint32_t p99;
+    uint32_t max;
+} latency_percentiles;
+
+typedef struct {
+    uint32_t frames;                // Frames closed by frame_done()
+    uint32_t reports;               // Of those, frames with a mouse report
+    uint32_t overruns;              // Frames whose processing ended after the next conversion
+    uint32_t window;                // Reported frames in the percentiles, up to LATENCY_TRACER_WINDOW
+    latency_percentiles segments[LATENCY_NUM_SEGMENTS];
+} latency_summary;
+
+
+class latency_tracer
+{
+
+public:
+    typedef uint32_t (*clock_fn)(void);
+
+    latency_tracer(clock_fn clock = us_ticker_read): _clock(clock) { reset(); }
+
+    uint32_t now(void) const { return _clock(); }
+
+    // Records point for the frame of conversion sequence. LATENCY_INTERRUPT starts the frame's record.
+    void mark(const uint32_t sequence, const latency_point point) { mark_at(sequence, point, _clock()); }
+    void mark_at(const uint32_t sequence, const latency_point point, const uint32_t timestamp_us);
+
+    // Closes the frame: counts an overrun and, with a LATENCY_HID_SUBMIT, adds it to the window.
+    // Returns false if the frame's record is incomplete or was overwritten.
+    bool frame_done(const uint32_t sequence);
+
+    void reset(void);
+
+    // Nearest rank percentiles over the window
+    void summary(latency_summary &out);
+
+    // Prints the summary with printf
+    void print(void);
+
+    static const char *segment_name(const latency_segment segment);
+
+    // Index of percentile (1-100) in n sorted samples, nearest rank
+    static uint32_t percentile_index(const uint32_t n, const uint32_t percentile)
+    {
+        const uint32_t rank = (n * percentile + 99u) / 100u;
+        return rank > 0 ? rank - 1 : 0;
+    }
+
+private:
+    typedef struct {
+        uint32_t sequence;
+        uint32_t valid;             // Bit per latency_point marked
+        bool overrun;
+        uint32_t t[LATENCY_NUM_POINTS];
+    } frame_record;
+
+    clock_fn _clock;
+
+    frame_record _frames[LATENCY_TRACER_SLOTS];
+    volatile uint32_t _last_interrupt = 0;     // Sequence of the latest LATENCY_INTERRUPT
+
+    // Segment durations of the last LATENCY_TRACER_WINDOW reported frames, oldest overwritten first
+    uint32_t _window[LATENCY_NUM_SEGMENTS][LATENCY_TRACER_WINDOW];
+    uint32_t _window_next = 0;
+    uint32_t _window_count = 0;
+    uint32_t _sorted[LATENCY_TRACER_WINDOW];
+
+    uint32_t _frames_done = 0;
+    uint32_t _reports = 0;
+    uint32_t _overruns = 0;
+
+};
+
+
+#endif // __LATENCY_TRACER_H__
@@ -0,0 +1,108 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* stage_profiler: per-stage timing of the frame processing path
+*/
+
+#include "stage_profiler.h"
+
+static stage_profiler profiler;
+
+stage_profiler &gesture_profiler()
+{
+    return profiler;
+}
+
+uint32_t stage_profiler::ticks_per_us()
+{
+#if defined(MBED_HOST_SHIM)
+    return 1000u;
+#else
+    return SystemCoreClock / 1000000u;
+#endif
+}
+
+void stage_profiler::start_counter()
+{
+#if !defined(MBED_HOST_SHIM)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+void stage_profiler::reset()
+{
+    memset(_stats, 0, sizeof(_stats));
+}
+
+uint32_t stage_profiler::average(const profile_stage stage) const
+{
+    const profile_stage_stats &s = _stats[stage];
+    return s.count > 0 ? (uint32_t)(s.total / s.count) : 0;
+}
+
+const char *stage_profiler::stage_name(const profile_stage stage)
+{
+    static const char *names[PROFILE_NUM_STAGES] = {
+        "read", "window_filter", "background", "roi", "interpolate", "threshold", "center_of_mass", "tracking", "output", "frame"
+    };
+    return stage < PROFILE_NUM_STAGES ? names[stage] : "?";
+}
+
+/*
+* One line per stage with samples. The histogram lists the non-empty buckets as <upper bound in us>:count.
+*/
+void stage_profiler::print() const
+{
+    const float us_per_tick = 1.0f / (float)ticks_per_us();
+
+    printf("%-16s %10s %10s %10s %10s  histogram (<us:count)\r\n", "stage", "count", "min us", "avg us", "max us");
+    for (unsigned int k = 0; k < PROFILE_NUM_STAGES; k++) {
+        const profile_stage stage = (profile_stage)k;
+        const profile_stage_stats &s = _stats[k];
+        if (s.count == 0) continue;
+
+        printf("%-16s %10lu %10.2f %10.2f %10.2f ", stage_name(stage), (unsigned long)s.count, s.min * us_per_tick,
+               average(stage) * us_per_tick, s.max * us_per_tick);
+        for (unsigned int b = 0; b < STAGE_PROFILER_BUCKETS; b++) {
+            if (s.buckets[b] == 0) continue;
+            if (b == STAGE_PROFILER_BUCKETS - 1) printf(" more:%lu", (unsigned long)s.buckets[b]);
+            else printf(" %.2f:%lu", (float)(1u << b) * us_per_tick, (unsigned long)s.buckets[b]);
+        }
+        printf("\r\n");
+    }
+}
@@ -0,0 +1,160 @@
+/*******************************************************************************
+* Copyright (C) Maxim Integrated Products, Inc., All rights Reserved.
+*
+* This software is protected by copyright laws of the United States and
+* of foreign countries. This material may also be protected by patent laws
+* and technology transfer regulations of the United States and of foreign
+* countries. This software is furnished under a license agreement and/or a
+* nondisclosure agreement and may only be used or reproduced in accordance
+* with the terms of those agreements. Dissemination of this information to
+* any party or parties not specified in the license agreement and/or
+* nondisclosure agreement is expressly prohibited.
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* Except as contained in this notice, the name of Maxim Integrated
+* Products, Inc. shall not be used except as stated in the Maxim Integrated
+* Products, Inc. Branding Policy.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Maxim Integrated Products, Inc. retains all
+* ownership rights.
+*******************************************************************************
+*/
+
+/*
+* stage_profiler: per-stage timing of the frame processing path
+*
+* Each stage (reading the pixels, the gesture_lib filters, thresholding, centre of mass, the mouse
+* report) keeps its count, min/avg/max and a histogram of durations. On the target the durations are
+* DWT cycle counts, on the host (MBED_HOST_SHIM) std::chrono nanoseconds; ticks_per_us() converts.
+*
+* Profiling is compiled out unless GESTURE_PROFILE is 1 (mbed_app.json "stage-profiler"): the
+* GESTURE_PROFILE_BEGIN/END macros expand to nothing, so the instrumented code is unchanged.
+* Enabled, a stage costs two counter reads and a few adds per frame.
+*
+* The histogram buckets are powers of two: bucket 0 counts durations of 0 ticks and bucket b > 0
+* those of 2^(b-1) up to 2^b - 1 ticks; the last bucket also takes everything longer.
+*
+* Every stage has to be recorded from one thread only (the acquisition thread of gesture_pipeline
+* records PROFILE_READ, the processing thread the others). Read the stats from the processing thread,
+* e.g. print() every few seconds, or send them in frame stream profile packets (frame_stream.h).
+*/
+
+#ifndef __STAGE_PROFILER_H__
+#define __STAGE_PROFILER_H__
+
+#include "mbed.h"
+#include <cstdint>
+
+#if !defined(MBED_HOST_SHIM)
+#include "cmsis.h"
+#endif
+
+#ifndef GESTURE_PROFILE
+#define GESTURE_PROFILE                         0
+#endif
+
+#define STAGE_PROFILER_BUCKETS                  (24u)       // Up to 2^23 ticks (87 ms at 96 MHz) apart from the last bucket
+
+typedef enum {
+    PROFILE_READ,                   // MAX25x05 pixel read (getSensorPixelInts)
+    PROFILE_WINDOW_FILTER,          // noiseWindow3Filter
+    PROFILE_BACKGROUND,             // subtractBackground
+    PROFILE_REGION_OF_INTEREST,     // findRegionOfInterest: sector energy and the interpolation window (not GEST_DYNAMIC_FAST)
+    PROFILE_INTERPOLATE,            // interpn (keepInterpFrame only)
+    PROFILE_THRESHOLD,              // zeroPixelsBelowThreshold (keepInterpFrame only)
+    PROFILE_CENTER_OF_MASS,         // calcCenterOfMass, or the fused interpolation, threshold and centre of mass
+    PROFILE_TRACKING,               // runTracking (GEST_TRACKING)
+    PROFILE_OUTPUT,                 // Mouse report
+    PROFILE_FRAME,                  // Whole frame on the processing thread, from taking the frame to the output
+    PROFILE_NUM_STAGES
+} profile_stage;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;                   // Ticks
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[STAGE_PROFILER_BUCKETS];
+} profile_stage_stats;
+
+
+class stage_profiler
+{
+
+public:
+    stage_profiler() { reset(); }
+
+    // Timestamp in ticks, wraps around; the difference of two timestamps is a duration
+    static inline uint32_t now(void)
+    {
+#if defined(MBED_HOST_SHIM)
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+        return DWT->CYCCNT;
+#endif
+    }
+
+    // Ticks per microsecond: the core clock in MHz on the target, 1000 on the host
+    static uint32_t ticks_per_us(void);
+
+    // Starts the DWT cycle counter on the target; the host clock always runs
+    static void start_counter(void);
+
+    inline void record(const profile_stage stage, const uint32_t ticks)
+    {
+        profile_stage_stats &s = _stats[stage];
+        if (s.count == 0 || ticks < s.min) s.min = ticks;
+        if (ticks > s.max) s.max = ticks;
+        s.count++;
+        s.total += ticks;
+        s.buckets[bucket(ticks)]++;
+    }
+
+    void reset(void);
+
+    const profile_stage_stats &stats(const profile_stage stage) const { return _stats[stage]; }
+    uint32_t average(const profile_stage stage) const;
+
+    static const char *stage_name(const profile_stage stage);
+
+    // Prints a table of the stages with samples (count, min/avg/max in us and the histogram) with printf
+    void print(void) const;
+
+    // Histogram bucket of a duration
+    static inline unsigned int bucket(const uint32_t ticks)
+    {
+        const unsigned int b = ticks == 0 ? 0 : 32u - (unsigned int)__builtin_clz(ticks);
+        return b < STAGE_PROFILER_BUCKETS ? b : STAGE_PROFILER_BUCKETS - 1;
+    }
+
+private:
+    profile_stage_stats _stats[PROFILE_NUM_STAGES];
+
+};
+
+// Profiler the GESTURE_PROFILE macros record into
+stage_profiler &gesture_profiler(void);
+
+#if GESTURE_PROFILE
+#define GESTURE_PROFILE_BEGIN(t)                const uint32_t t = stage_profiler::now()
+#define GESTURE_PROFILE_END(stage, t)           gesture_profiler().record(stage, stage_profiler::now() - (t))
+#else
+#define GESTURE_PROFILE_BEGIN(t)
+#define GESTURE_PROFILE_END(stage, t)           ((void)0)
+#endif
+
+
+#endif // __STAGE_PROFILER_H__